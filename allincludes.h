@@ -15,11 +15,28 @@
 #define DEBUGSERIAL  Serial  // used for messages while debugging the PortaProg code
 #define CHIPSERIAL   Serial1 // used to communicate with an attached device
 
-#define DEBUG(fmt, ...)     DEBUGSERIAL.printf(fmt, ##__VA_ARGS__)
-//#define VERBOSE(fmt, ...)   DEBUGSERIAL.printf(fmt, ##__VA_ARGS__)
+// messages are kept in the log ring (see log.h) and sent to DEBUGSERIAL by logLoop();
+// levels above LOG_LEVEL compile to nothing
+#define LOG_LEVEL_NONE    0
+#define LOG_LEVEL_MESSAGE 1
+#define LOG_LEVEL_DEBUG   2
+#define LOG_LEVEL_VERBOSE 3
+#ifndef LOG_LEVEL
+  #define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+void logRecord(uint8_t level, const char *fmt, ...);
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+  #define DEBUG(fmt, ...)   logRecord(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_VERBOSE
+  #define VERBOSE(fmt, ...) logRecord(LOG_LEVEL_VERBOSE, fmt, ##__VA_ARGS__)
+#endif
 
 //#define VERBOSEON(fmt, ...) DEBUGSERIAL.printf(fmt, ##__VA_ARGS__)
-#define MESSAGE(fmt, ...)   ioStreamPrintf(NULL, fmt, ##__VA_ARGS__)
+#if LOG_LEVEL >= LOG_LEVEL_MESSAGE
+  #define MESSAGE(fmt, ...) logRecord(LOG_LEVEL_MESSAGE, fmt, ##__VA_ARGS__)
+#endif
 #define CLIENTMSG(fmt, ...) ioStreamPrintf(client, fmt, ##__VA_ARGS__)
 
 #ifndef DEBUG
@@ -50,9 +67,15 @@ char g_network_buf[MAX_NETWORK_TEXT + 1 + 1]; // buffer + '\n' + 0
 int configWifiPort = 0;
 
 
+#include "log.h"
+#include "bufferstream.h"
+#include "pipeline.h"
+#include "lzstream.h"
+#include "digest.h"
+#include "hexfile.h"
+#include "storage.h"
 #include "filesys.h"
 #include "parser.h"
-#include "bufferstream.h"
 #include "io.h"
 
 #endif
@@ -1,26 +1,58 @@
 #ifndef __BUFFERSTREAM_H
 #define __BUFFERSTREAM_H
 
-// by tracking 'stored_size' and 'unread_size' we are able to rewind the buffer repeat using it
+#include <atomic>
+
+/*
+  the buffer is a queue of fixed size segments. segments are added at the tail as data is
+  written and handed back as the head is drained, so an idle buffer holds at most one spare
+  segment while a busy one grows up to buffer_size. the first segments come from internal RAM;
+  when they are in use, the overflow comes from PSRAM if there is any.
+
+  mark() keeps the data from the read position on, also after it has been read; rewind() goes
+  back to the mark so the same commands can be read again without copying them.
+*/
 class bufferStream : public Stream
 {
 private:
-  // the input (buffer) properties
-  uint8_t *buffer;
+  typedef struct segment_s
+  {
+    struct segment_s *next;
+    bool internal;            // allocated from internal RAM
+    uint8_t data[];
+  } segment_t;
+
+  segment_t *head;            // the oldest segment; it holds the mark when there is one
+  segment_t *reader;          // reading continues here; the same as head without a mark
+  segment_t *tail;            // writing continues here
+  segment_t *spare;           // a drained segment which is kept for the next write
+  uint16_t internal_count;    // segments in internal RAM, including the spare
   int32_t buffer_size, stored_size;
-  int32_t buffer_pos, unread_size;
+  uint32_t read_pos, tail_fill; // the read offset in the reader and the write offset in the tail; at most SEGMENT_SIZE
+  int32_t unread_size;
+  uint32_t mark_pos;          // the offset of the mark in the head
+  int32_t kept_size;          // bytes which have been read since the mark
+  bool marked;
   uint16_t errors;
 
+  void releaseRead();
+
+  segment_t *allocSegment();
+  void releaseSegment(segment_t *segment);
+
 public:
   static const uint32_t DEFAULT_SIZE = 256;
+  static const uint32_t SEGMENT_SIZE = 1024;
+  static const uint16_t INTERNAL_SEGMENTS = 2; // more segments than this come from PSRAM when it exists
 
   bufferStream(uint32_t buffer_size = bufferStream::DEFAULT_SIZE);
   ~bufferStream();
 
-  // operations to change internal buffer
-
   // operations to change internal buffer
   void clear();
+  void mark();
+  bool rewind();
+  void reset();
 
   // read from internal buffer
   virtual int32_t available();
@@ -32,11 +64,24 @@ public:
   virtual int availableForWrite(void);
   virtual size_t write(uint8_t);
   int32_t writeStream(Stream *src);
+
+  // bulk operations; the data is copied segment by segment
+  virtual size_t write(const uint8_t *data, size_t len);
+  virtual size_t readBytes(char *data, size_t len);
+  size_t readBytes(uint8_t *data, size_t len) { return readBytes((char *)data, len); }
+  using Print::write;
+
+  // contiguous regions of the buffer for callers which drain or fill it in place
+  size_t peekSpan(const uint8_t **data);
+  void consume(size_t len);
+  size_t writeSpan(uint8_t **data);
+  void commit(size_t len);
 };
 /* ---
 #### bufferStream::bufferStream()
 
 Implements a compatible stream class where print() and write() operates on the device display.
+The buffer starts empty and grows in SEGMENT_SIZE steps up to `buffer_size` bytes.
 
 --- */
 
@@ -44,56 +89,152 @@ bufferStream::bufferStream(uint32_t buffer_size)
 {
   VERBOSE("bufferStream::bufferStream\n");
 
-  this->buffer = NULL;
-  VERBOSE("Total heap:  %7d bytes\n", ESP.getHeapSize());
-  VERBOSE("Free heap:   %7d bytes\n", ESP.getFreeHeap());
-  VERBOSE("Total PSRAM: %7d bytes\n", ESP.getPsramSize());
-  VERBOSE("Free PSRAM:  %7d bytes\n", ESP.getFreePsram());
-  VERBOSE("--------------------------\n");
-
-  // TODO consider making the buffer a list of buffers so they can be allocated within the ESP32 RAM
-  if (ESP.getFreePsram() > buffer_size)
-    this->buffer = (uint8_t *)ps_malloc(buffer_size);
-  if (this->buffer == NULL)
-    this->buffer = (uint8_t *)malloc(buffer_size);
-  if (this->buffer == NULL)
-    this->buffer_size = 0;
-  else
-    this->buffer_size = buffer_size;
+  this->head = NULL;
+  this->reader = NULL;
+  this->tail = NULL;
+  this->spare = NULL;
+  this->internal_count = 0;
+  this->buffer_size = buffer_size;
+  this->unread_size = 0;
 
-  MESSAGE("Display buffer %d KB\n", (this->buffer_size / 1024));
+  MESSAGE("Input buffer up to %d KB in %d byte segments\n", (this->buffer_size / 1024), SEGMENT_SIZE);
 
-  VERBOSE("--------------------------\n");
+  this->clear();
+}
 
-  VERBOSE("Total heap:  %7d bytes\n", ESP.getHeapSize());
-  VERBOSE("Free heap:   %7d bytes\n", ESP.getFreeHeap());
-  VERBOSE("Total PSRAM: %7d bytes\n", ESP.getPsramSize());
-  VERBOSE("Free PSRAM:  %7d bytes\n", ESP.getFreePsram());
+bufferStream::~bufferStream()
+{
+  clear();
+  if (spare)
+    free(spare);
+}
 
-  this->clear();
+bufferStream::segment_t *bufferStream::allocSegment()
+{
+  segment_t *segment = spare;
+  if (segment)
+  {
+    spare = NULL;
+    return segment;
+  }
 
-  /*
-    this uses a circular buffer:
-      the buffer_size is a constant.
-      the buffer_pos is the index of the next byte to read
-      the unread_size is number of unread bytes
-    read from the beginning and write to the end
-    wrap at end of the buffer
-  */
+  bool internal = (internal_count < INTERNAL_SEGMENTS);
+  if (!internal && (ESP.getFreePsram() > SEGMENT_SIZE))
+    segment = (segment_t *)ps_malloc(sizeof(segment_t) + SEGMENT_SIZE);
+  if (segment == NULL)
+  {
+    segment = (segment_t *)malloc(sizeof(segment_t) + SEGMENT_SIZE);
+    internal = true;
+  }
+  if (segment == NULL)
+    return NULL;
+  segment->internal = internal;
+  if (internal)
+    internal_count++;
+  return segment;
 }
 
-bufferStream::~bufferStream()
+void bufferStream::releaseSegment(segment_t *segment)
 {
-  free(buffer);
+  //-- one segment is kept; an internal one is preferred
+  if (spare && (spare->internal || !segment->internal))
+  {
+    if (segment->internal)
+      internal_count--;
+    free(segment);
+    return;
+  }
+  if (spare)
+  {
+    if (spare->internal)
+      internal_count--;
+    free(spare);
+  }
+  spare = segment;
 }
 
 void bufferStream::clear()
 {
-  buffer_pos = 0;
+  while (head)
+  {
+    segment_t *next = head->next;
+    releaseSegment(head);
+    head = next;
+  }
+  reader = NULL;
+  tail = NULL;
+  read_pos = 0;
+  tail_fill = 0;
   unread_size = 0;
   stored_size = 0;
+  kept_size = 0;
+  marked = false;
   errors = 0;
-  memset(buffer, 0, buffer_size);
+}
+
+// hand back the segments before the read position
+void bufferStream::releaseRead()
+{
+  while (head != reader)
+  {
+    segment_t *next = head->next;
+    releaseSegment(head);
+    head = next;
+  }
+}
+
+/* ---
+#### bufferStream::mark()
+
+Keep the data from the read position on; rewind() returns to it. A new mark replaces the old one.
+The kept data counts against the size of the buffer until reset() or clear().
+--- */
+void bufferStream::mark()
+{
+  releaseRead();
+  if (!unread_size)
+  {
+    read_pos = 0;
+    tail_fill = 0;
+  }
+  mark_pos = read_pos;
+  kept_size = 0;
+  marked = true;
+}
+
+/* ---
+#### bufferStream::rewind()
+
+Return the read position to the mark. The mark stays, so the data may be read again and again.
+
+- return: **bool** `false` when there is no mark
+--- */
+bool bufferStream::rewind()
+{
+  if (!marked)
+    return false;
+  reader = head;
+  read_pos = mark_pos;
+  unread_size += kept_size;
+  kept_size = 0;
+  return true;
+}
+
+/* ---
+#### bufferStream::reset()
+
+Forget the mark and hand back the data which has been read.
+--- */
+void bufferStream::reset()
+{
+  releaseRead();
+  marked = false;
+  kept_size = 0;
+  if (!unread_size)
+  {
+    read_pos = 0;
+    tail_fill = 0;
+  }
 }
 
 // ------------------------------------------------------
@@ -104,90 +245,768 @@ void bufferStream::clear()
 
 int32_t bufferStream::available()
 {
-  if (buffer == NULL)
-    return 0;
-
   return unread_size;
 }
 
 int bufferStream::peek()
 {
-  return ((unread_size == 0) ? -1 : buffer[buffer_pos]);
+  return ((unread_size == 0) ? -1 : reader->data[read_pos]);
 }
 
 int bufferStream::read()
 {
-  if (buffer == NULL)
-    return -1;
   if (unread_size == 0)
   {
     errors++;
     return -1;
   }
-  else
+  int ret = reader->data[read_pos];
+  if ((read_pos + 1 < SEGMENT_SIZE) && (unread_size > 1))
   {
-    int ret = buffer[buffer_pos];
-    buffer_pos++;
+    //-- the common case: the byte is not the last of its segment or of the buffer
+    read_pos++;
     unread_size--;
-    if (buffer_pos == buffer_size)
-    {
-      buffer_pos = 0;
-    }
-    errors = 0;
-    return ret;
+    kept_size += marked;
   }
+  else
+    consume(1);
+  errors = 0;
+  return ret;
 }
 
 size_t bufferStream::write(uint8_t b)
 {
-  if (buffer == NULL)
+  if (tail && (tail_fill < SEGMENT_SIZE) && ((unread_size + kept_size) < buffer_size))
+  {
+    //-- the common case: there is room in the tail segment
+    tail->data[tail_fill++] = b;
+    unread_size++;
+    stored_size++;
+    return 1;
+  }
+  uint8_t *span;
+  if (!writeSpan(&span))
+  {
+    errors++;
     return 0;
-  if (unread_size == buffer_size)
+  }
+  *span = b;
+  commit(1);
+  return 1;
+}
+
+int32_t bufferStream::availableForWrite()
+{
+  // the room up to the size limit; the segments are allocated as they are needed
+  return buffer_size - unread_size - kept_size;
+}
+
+int32_t bufferStream::writeStream(Stream *src)
+{
+  VERBOSE("loadStream()\n");
+  int32_t count = 0;
+  int available;
+
+  //-- the source fills the free space in place
+  uint8_t *span;
+  size_t len;
+  while (((available = src->available()) > 0) && ((len = writeSpan(&span)) > 0))
+  {
+    if (len > (size_t)available)
+      len = available;
+    len = src->readBytes(span, len);
+    if (!len)
+      break;
+    commit(len);
+    count += len;
+  }
+
+  //-- whatever does not fit is dropped
+  uint8_t scrap[64];
+  while ((available = src->available()) > 0)
+  {
+    size_t dropped = src->readBytes(scrap, ((size_t)available < sizeof(scrap)) ? available : sizeof(scrap));
+    if (!dropped)
+      break;
+    errors += dropped;
+  }
+  return count;
+}
+
+size_t bufferStream::write(const uint8_t *data, size_t len)
+{
+  size_t count = 0;
+  uint8_t *span;
+  size_t room;
+  while ((count < len) && ((room = writeSpan(&span)) > 0))
+  {
+    if (room > (len - count))
+      room = len - count;
+    memcpy(span, data + count, room);
+    commit(room);
+    count += room;
+  }
+  if (count < len)
+    errors++;
+  return count;
+}
+
+size_t bufferStream::readBytes(char *data, size_t len)
+{
+  // unlike Stream::readBytes() this does not wait; the buffer gets no more data while it is read
+  size_t count = 0;
+  const uint8_t *span;
+  size_t part;
+  while ((count < len) && ((part = peekSpan(&span)) > 0))
   {
+    if (part > (len - count))
+      part = len - count;
+    memcpy(data + count, span, part);
+    consume(part);
+    count += part;
+  }
+  if (len && !count)
     errors++;
+  else if (count)
+    errors = 0;
+  return count;
+}
+
+size_t bufferStream::peekSpan(const uint8_t **data)
+{
+  // the unread data up to the end of the reader segment
+  if (unread_size == 0)
     return 0;
+  *data = reader->data + read_pos;
+  int32_t len = SEGMENT_SIZE - read_pos;
+  return (unread_size < len) ? unread_size : len;
+}
+
+void bufferStream::consume(size_t len)
+{
+  // the sizes are never negative
+  if (len > (size_t)unread_size)
+    len = unread_size;
+  unread_size -= len;
+  read_pos += len;
+  if (marked)
+    kept_size += len;
+  //-- drained segments are handed back unless they are kept for rewind(); the tail stays
+  while ((read_pos >= SEGMENT_SIZE) && reader->next)
+  {
+    reader = reader->next;
+    read_pos -= SEGMENT_SIZE;
+    if (!marked)
+      releaseRead();
   }
-  else
+  if (!unread_size && !marked)
+  {
+    //-- an empty buffer starts again at the beginning of its only segment
+    read_pos = 0;
+    tail_fill = 0;
+  }
+}
+
+size_t bufferStream::writeSpan(uint8_t **data)
+{
+  // the free space of the tail segment; a new segment is added when the tail is full
+  int32_t room = buffer_size - unread_size - kept_size;
+  if (room <= 0)
+    return 0;
+  if (!tail || (tail_fill == SEGMENT_SIZE))
   {
-    int32_t i = buffer_pos + unread_size;
-    if (i >= buffer_size)
+    segment_t *segment = allocSegment();
+    if (!segment)
+      return 0;
+    segment->next = NULL;
+    if (tail)
+      tail->next = segment;
+    else
+      head = reader = segment;
+    if (read_pos == SEGMENT_SIZE)
     {
-      i -= buffer_size;
+      //-- everything has been read and the read segment is kept for rewind()
+      reader = segment;
+      read_pos = 0;
     }
-    buffer[i] = b;
-    unread_size++;
-    stored_size++;
+    tail = segment;
+    tail_fill = 0;
+  }
+  *data = tail->data + tail_fill;
+  int32_t len = SEGMENT_SIZE - tail_fill;
+  return (room < len) ? room : len;
+}
+
+void bufferStream::commit(size_t len)
+{
+  size_t room = buffer_size - unread_size - kept_size;
+  if (len > room)
+    len = room;
+  if (len > (SEGMENT_SIZE - tail_fill))
+    len = SEGMENT_SIZE - tail_fill;
+  tail_fill += len;
+  unread_size += len;
+  stored_size += len;
+}
+
+void bufferStream::flush()
+{
+}
+
+
+/*
+  a ring of a fixed size N, which must be a power of two. the storage is part of the object,
+  so there is no allocation and no check for a missing buffer, and the indices wrap with a mask.
+  the indices run freely; the difference of the two is the unread size. it is meant for
+  buffers whose size is known when the code is written, eg a line buffer of a server.
+*/
+template <uint32_t N>
+class fixedBufferStream : public Stream
+{
+  static_assert((N > 0) && ((N & (N - 1)) == 0), "fixedBufferStream size must be a power of two");
+  static const uint32_t MASK = N - 1;
+
+private:
+  uint8_t buffer[N];
+  uint32_t head;     // the next byte to read
+  uint32_t tail;     // the next byte to write
+
+public:
+  fixedBufferStream() : head(0), tail(0) {}
+
+  void clear()
+  {
+    head = 0;
+    tail = 0;
+  }
+
+  virtual int available() { return tail - head; }
+  virtual int availableForWrite() { return N - (tail - head); }
+  virtual void flush() {}
+
+  virtual int peek()
+  {
+    return (head == tail) ? -1 : buffer[head & MASK];
+  }
+
+  virtual int read()
+  {
+    return (head == tail) ? -1 : buffer[head++ & MASK];
+  }
+
+  virtual size_t write(uint8_t b)
+  {
+    if ((tail - head) == N)
+      return 0;
+    buffer[tail++ & MASK] = b;
     return 1;
   }
+
+  // bulk operations; at most two copies around the wrap point
+  virtual size_t write(const uint8_t *data, size_t len)
+  {
+    uint32_t count = N - (tail - head);
+    if (count > len)
+      count = len;
+    uint32_t pos = tail & MASK;
+    uint32_t part = (count < (N - pos)) ? count : (N - pos);
+    memcpy(buffer + pos, data, part);
+    memcpy(buffer, data + part, count - part);
+    tail += count;
+    return count;
+  }
+
+  virtual size_t readBytes(char *data, size_t len)
+  {
+    // like bufferStream::readBytes() this does not wait
+    uint32_t count = tail - head;
+    if (count > len)
+      count = len;
+    uint32_t pos = head & MASK;
+    uint32_t part = (count < (N - pos)) ? count : (N - pos);
+    memcpy(data, buffer + pos, part);
+    memcpy(data + part, buffer, count - part);
+    head += count;
+    return count;
+  }
+  size_t readBytes(uint8_t *data, size_t len) { return readBytes((char *)data, len); }
+  using Print::write;
+
+  // contiguous regions up to the wrap point, as in bufferStream
+  size_t peekSpan(const uint8_t **data)
+  {
+    uint32_t pos = head & MASK;
+    uint32_t len = tail - head;
+    *data = buffer + pos;
+    return (len < (N - pos)) ? len : (N - pos);
+  }
+
+  void consume(size_t len)
+  {
+    head += (len < (tail - head)) ? len : (tail - head);
+  }
+
+  size_t writeSpan(uint8_t **data)
+  {
+    uint32_t pos = tail & MASK;
+    uint32_t len = N - (tail - head);
+    *data = buffer + pos;
+    return (len < (N - pos)) ? len : (N - pos);
+  }
+
+  void commit(size_t len)
+  {
+    uint32_t room = N - (tail - head);
+    tail += (len < room) ? len : room;
+  }
+};
+
+/*
+  a single producer / single consumer ring. one task writes and another task reads without a lock:
+  the producer only stores head and the consumer only stores tail. the data is published by the
+  release store of head and handed back by the release store of tail, so a batch of bytes costs
+  one atomic store. each side keeps a copy of the other side's index and only loads the shared
+  one when its copy says the ring is full (or empty). the indices run freely and are masked, so
+  the capacity is a power of two.
+
+  each side stores only into its own cache line. buffer and mask are read by both sides and
+  never stored after the constructor, so they stay on the first line with the Stream fields.
+  the class is aligned to the line, and new allocates it aligned, as new of C++11 does not.
+
+  clear() is only safe while neither side is using the ring.
+*/
+#define RING_CACHE_LINE 64 // the producer and the consumer indices are kept on lines of their own
+
+class ringStream : public Stream
+{
+private:
+  uint8_t *buffer;
+  uint32_t mask;                  // capacity - 1
+
+  alignas(RING_CACHE_LINE) std::atomic<uint32_t> head; // the next byte to write; stored by the producer
+  uint32_t tail_seen;             // the producer's copy of tail
+
+  alignas(RING_CACHE_LINE) std::atomic<uint32_t> tail; // the next byte to read; stored by the consumer
+  uint32_t head_seen;             // the consumer's copy of head
+
+public:
+  ringStream(uint32_t size);
+  ~ringStream();
+  static void *operator new(size_t size) noexcept;
+  static void operator delete(void *ptr) { free(ptr); }
+
+  void clear();
+  uint32_t capacity() { return buffer ? mask + 1 : 0; }
+
+  // consumer side
+  virtual int available();
+  virtual int peek();
+  virtual int read();
+  virtual size_t readBytes(char *data, size_t len);
+  size_t readBytes(uint8_t *data, size_t len) { return readBytes((char *)data, len); }
+  size_t peekSpan(const uint8_t **data);
+  void consume(size_t len);
+
+  // producer side
+  virtual int availableForWrite();
+  virtual size_t write(uint8_t b);
+  virtual size_t write(const uint8_t *data, size_t len);
+  using Print::write;
+  size_t writeSpan(uint8_t **data);
+  void commit(size_t len);
+  virtual void flush();
+};
+
+/* ---
+#### ringStream::ringStream()
+
+- input: size **uint32_t** the capacity; it is rounded up to a power of two
+--- */
+ringStream::ringStream(uint32_t size)
+{
+  uint32_t capacity = 1;
+  while (capacity < size)
+    capacity <<= 1;
+  buffer = (uint8_t *)malloc(capacity);
+  mask = capacity - 1;
+  if (!buffer)
+    MESSAGE("ERROR: no memory for a %u byte ring\n", capacity);
+  clear();
 }
 
-int32_t bufferStream::availableForWrite()
+ringStream::~ringStream()
 {
-  if (buffer == NULL)
+  free(buffer);
+}
+
+void *ringStream::operator new(size_t size) noexcept
+{
+  // NULL when there is no memory; the caller checks
+  void *ptr = NULL;
+  if (posix_memalign(&ptr, RING_CACHE_LINE, size))
+    return NULL;
+  return ptr;
+}
+
+void ringStream::clear()
+{
+  head.store(0, std::memory_order_relaxed);
+  tail.store(0, std::memory_order_relaxed);
+  tail_seen = 0;
+  head_seen = 0;
+}
+
+int ringStream::available()
+{
+  head_seen = head.load(std::memory_order_acquire);
+  return head_seen - tail.load(std::memory_order_relaxed);
+}
+
+int ringStream::peek()
+{
+  uint32_t t = tail.load(std::memory_order_relaxed);
+  if ((t == head_seen) && (t == (head_seen = head.load(std::memory_order_acquire))))
+    return -1;
+  return buffer[t & mask];
+}
+
+int ringStream::read()
+{
+  uint32_t t = tail.load(std::memory_order_relaxed);
+  if ((t == head_seen) && (t == (head_seen = head.load(std::memory_order_acquire))))
+    return -1;
+  int ret = buffer[t & mask];
+  tail.store(t + 1, std::memory_order_release);
+  return ret;
+}
+
+size_t ringStream::peekSpan(const uint8_t **data)
+{
+  // the unread data up to the wrap point
+  uint32_t t = tail.load(std::memory_order_relaxed);
+  head_seen = head.load(std::memory_order_acquire);
+  uint32_t len = head_seen - t;
+  uint32_t pos = t & mask;
+  if (len > (mask + 1 - pos))
+    len = mask + 1 - pos;
+  *data = buffer + pos;
+  return len;
+}
+
+void ringStream::consume(size_t len)
+{
+  uint32_t t = tail.load(std::memory_order_relaxed);
+  if (len > (head_seen - t))
+    len = head_seen - t;
+  tail.store(t + len, std::memory_order_release);
+}
+
+size_t ringStream::readBytes(char *data, size_t len)
+{
+  // like bufferStream::readBytes() this does not wait
+  uint32_t t = tail.load(std::memory_order_relaxed);
+  if ((head_seen - t) < len)
+    head_seen = head.load(std::memory_order_acquire);
+  uint32_t count = head_seen - t;
+  if (count > len)
+    count = len;
+  uint32_t pos = t & mask;
+  uint32_t part = mask + 1 - pos;
+  if (part > count)
+    part = count;
+  memcpy(data, buffer + pos, part);
+  memcpy(data + part, buffer, count - part);
+  tail.store(t + count, std::memory_order_release);
+  return count;
+}
+
+int ringStream::availableForWrite()
+{
+  if (!buffer)
     return 0;
-  return buffer_size - unread_size;
+  tail_seen = tail.load(std::memory_order_acquire);
+  return mask + 1 - (head.load(std::memory_order_relaxed) - tail_seen);
 }
 
-int32_t bufferStream::writeStream(Stream *src)
+size_t ringStream::write(uint8_t b)
 {
-  VERBOSE("loadStream()\n");
-  if (buffer == NULL)
+  if (!buffer)
     return 0;
-  int c;
-  int32_t count = 0;
+  uint32_t h = head.load(std::memory_order_relaxed);
+  if (((h - tail_seen) > mask) && ((h - (tail_seen = tail.load(std::memory_order_acquire))) > mask))
+    return 0;
+  buffer[h & mask] = b;
+  head.store(h + 1, std::memory_order_release);
+  return 1;
+}
+
+size_t ringStream::writeSpan(uint8_t **data)
+{
+  // the free space after the unread data up to the wrap point
+  if (!buffer)
+    return 0;
+  uint32_t h = head.load(std::memory_order_relaxed);
+  tail_seen = tail.load(std::memory_order_acquire);
+  uint32_t len = mask + 1 - (h - tail_seen);
+  uint32_t pos = h & mask;
+  if (len > (mask + 1 - pos))
+    len = mask + 1 - pos;
+  *data = buffer + pos;
+  return len;
+}
 
-  while ((c = src->read()) >= 0)
+void ringStream::commit(size_t len)
+{
+  uint32_t h = head.load(std::memory_order_relaxed);
+  if (len > (mask + 1 - (h - tail_seen)))
+    len = mask + 1 - (h - tail_seen);
+  head.store(h + len, std::memory_order_release);
+}
+
+size_t ringStream::write(const uint8_t *data, size_t len)
+{
+  if (!buffer)
+    return 0;
+  uint32_t h = head.load(std::memory_order_relaxed);
+  if ((mask + 1 - (h - tail_seen)) < len)
+    tail_seen = tail.load(std::memory_order_acquire);
+  uint32_t count = mask + 1 - (h - tail_seen);
+  if (count > len)
+    count = len;
+  uint32_t pos = h & mask;
+  uint32_t part = mask + 1 - pos;
+  if (part > count)
+    part = count;
+  memcpy(buffer + pos, data, part);
+  memcpy(buffer, data + part, count - part);
+  head.store(h + count, std::memory_order_release);
+  return count;
+}
+
+void ringStream::flush()
+{
+  // every write is published when it returns
+}
+
+
+/*
+  a cork holds the output for a Stream, eg a network client, so many small prints leave as a few
+  writes of CORK_SIZE bytes. it is sent when it is full, on flush() and on end(). printf() formats
+  straight into the cork. input passes through to the Stream. the buffer may be given to begin();
+  otherwise it is allocated by the first write and released by end(). without memory the output
+  goes straight to the Stream.
+
+  ioStreamPrintf() finds the cork of a Stream with corkStream::of(); active corks are kept in a list.
+  the cork counts the bytes written through it and the error messages, so a parser session can
+  report the length and the status of each response. output which the Stream refused is not counted.
+*/
+#define CORK_SIZE 1436 // one TCP MSS
+
+class corkStream : public Stream
+{
+private:
+  Stream *out;
+  uint8_t *buffer;
+  uint16_t fill;
+  bool owned;                 // the buffer was allocated by the cork
+  uint32_t written;           // bytes the Stream has taken since begin()
+  uint16_t errors;            // messages counted by error()
+  corkStream *next;           // the list of corks
+  static corkStream *corks;
+
+  size_t send(const uint8_t *data, size_t len);
+
+public:
+  corkStream();
+  ~corkStream();
+
+  void begin(Stream *out, uint8_t *buffer = NULL);
+  void end();
+  Stream *stream() { return out; }
+  static corkStream *of(Stream *stream);
+  uint32_t count() { return written + fill; }
+  uint16_t errorCount() { return errors; }
+  void error() { errors++; }
+
+  // input comes from the Stream
+  virtual int available() { return out->available(); }
+  virtual int peek() { return out->peek(); }
+  virtual int read() { return out->read(); }
+  virtual size_t readBytes(char *data, size_t len) { return out->readBytes(data, len); }
+
+  virtual int availableForWrite();
+  virtual size_t write(uint8_t b);
+  virtual size_t write(const uint8_t *data, size_t len);
+  using Print::write;
+  int vprintf(const char *fmt, va_list args);
+  virtual void flush();
+};
+
+corkStream *corkStream::corks = NULL;
+
+corkStream::corkStream()
+{
+  out = NULL;
+  buffer = NULL;
+  fill = 0;
+  owned = false;
+  written = 0;
+  errors = 0;
+  next = corks;
+  corks = this;
+}
+
+corkStream::~corkStream()
+{
+  end();
+  for (corkStream **link = &corks; *link; link = &((*link)->next))
   {
-    if (this->write(c) == 0)
-      errors++;
-    else
-      count++;
+    if (*link == this)
+    {
+      *link = next;
+      break;
+    }
   }
-  return count;
 }
 
-void bufferStream::flush()
+/* ---
+#### corkStream::begin()
+
+- input: out **Stream ptr** the Stream which gets the output and provides the input
+- input: buffer **uint8_t ptr** CORK_SIZE bytes which the caller owns; NULL to allocate them when they are needed
+--- */
+void corkStream::begin(Stream *out, uint8_t *buffer)
+{
+  this->out = out;
+  this->buffer = buffer;
+  owned = (buffer == NULL);
+  fill = 0;
+  written = 0;
+  errors = 0;
+}
+
+/* ---
+#### corkStream::end()
+
+Send what is held and release the buffer. The cork may be started again with begin().
+--- */
+void corkStream::end()
+{
+  if (!out)
+    return;
+  flush();
+  if (owned)
+    free(buffer);
+  buffer = NULL;
+  out = NULL;
+}
+
+/* ---
+#### corkStream::of()
+
+- input: stream **Stream ptr** any Stream
+- return: **corkStream ptr** the Stream when it is an active cork, otherwise NULL
+--- */
+corkStream *corkStream::of(Stream *stream)
+{
+  for (corkStream *cork = corks; cork; cork = cork->next)
+  {
+    if ((cork == stream) && cork->out)
+      return cork;
+  }
+  return NULL;
+}
+
+int corkStream::availableForWrite()
+{
+  // what the Stream takes after the cork has been sent; 0 when the Stream does not say
+  int room = out->availableForWrite();
+  if ((room <= 0) || (room > fill))
+    return (room > 0) ? (room - fill) : room;
+  //-- the Stream is nearly full; the cork goes first so its room is reported as it is
+  flush();
+  return out->availableForWrite();
+}
+
+size_t corkStream::write(uint8_t b)
 {
+  return write(&b, 1);
+}
+
+size_t corkStream::write(const uint8_t *data, size_t len)
+{
+  if (!buffer && !(buffer = (uint8_t *)malloc(CORK_SIZE)))
+    return send(data, len);
+
+  if ((fill + len) > CORK_SIZE)
+    flush();
+  if (len >= CORK_SIZE)
+    return send(data, len); //-- a large write goes out as it is
+  memcpy(buffer + fill, data, len);
+  fill += len;
+  if (fill == CORK_SIZE)
+    flush();
+  return len;
+}
+
+/* ---
+#### corkStream::vprintf()
+
+Format straight into the cork. Text longer than CORK_SIZE - 1 is cut.
+
+- input: fmt **char ptr** the format
+- input: args **va_list** the arguments
+- return: **int** the number of characters added
+--- */
+int corkStream::vprintf(const char *fmt, va_list args)
+{
+  if (!buffer && !(buffer = (uint8_t *)malloc(CORK_SIZE)))
+  {
+    char line[MAX_NETWORK_TEXT + 1];
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    if (len < 0)
+      return 0;
+    return send((uint8_t *)line, ((size_t)len < sizeof(line)) ? len : (sizeof(line) - 1));
+  }
+
+  va_list again;
+  va_copy(again, args);
+  int len = vsnprintf((char *)buffer + fill, CORK_SIZE - fill, fmt, args);
+  if ((len >= 0) && (len >= (CORK_SIZE - fill)))
+  {
+    //-- it does not fit; send what is held and format it again at the start
+    flush();
+    len = vsnprintf((char *)buffer, CORK_SIZE, fmt, again);
+    if (len >= CORK_SIZE)
+      len = CORK_SIZE - 1;
+  }
+  va_end(again);
+  if (len < 0)
+    return 0;
+  fill += len;
+  return len;
+}
+
+void corkStream::flush()
+{
+  // the held output goes out in one write; the Stream is not flushed, for a WiFiClient that drops its input
+  send(buffer, fill);
+  fill = 0;
+}
+
+size_t corkStream::send(const uint8_t *data, size_t len)
+{
+  // a short write is retried with the rest; returns what the Stream took, which is less once the client has gone
+  size_t done = 0;
+  while (done < len)
+  {
+    size_t count = out->write(data + done, len - done);
+    if (!count)
+      break; //-- the client has gone
+    done += count;
+  }
+  written += done;
+  return done;
 }
 
 #endif
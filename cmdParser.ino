@@ -54,7 +54,14 @@ const char *password  = WIFI_PASSWORD;
 #define TCP_PORT          8888  // could be anything for starters adn the user can override it with the .config file
 #define TELNET_PORT         23  // its default
 #define ALLOW_TELNET
-#define TCP_TIMEOUT       1500  // milliseconds
+#define TCP_TIMEOUT       1500  // milliseconds to wait for the first data of a new connection
+#define TCP_IDLE_TIMEOUT   250  // milliseconds of silence which end a command batch
+#define TCP_KEEPALIVE_TIMEOUT 60000 // milliseconds of silence which close a connection in KEEPALIVE mode
+#ifndef TCP_MAX_CLIENTS
+  #define TCP_MAX_CLIENTS    4  // concurrent TCP clients; each has its own parser session and output buffer
+#endif
+#define WIFI_IDLE_WAIT      10  // milliseconds loop() sleeps in select() when no socket is ready; Serial and the UART are checked this often
+#define WIFI_BUSY_WAIT       1  // milliseconds between the polls of a session which is sending or has input buffered
 #define MAX_FILENAME_LEN    32
 //----
 
@@ -68,10 +75,12 @@ const char *password  = WIFI_PASSWORD;
 #include <WiFiMulti.h>
 #include <WebServer.h>
 #include <ESPmDNS.h>
+#include <lwip/sockets.h>
 #include <functional>
 
 //--- prototypes ------------------------------------------------
 bool      parserProcessCommands(Stream *client, bool aborted);
+bool      parserRunCommandFile(Stream *client, const char *name, bool aborted);
 
 bool      ioInit();
 void      ioLoop();
@@ -80,79 +89,251 @@ int       ioStreamPrint(Stream *out, const char *line);
 int       ioStreamPrintf(Stream *out, const char *fmt, ...);
 bool      ioRunCommandLine(const char *commands, bool aborted, bool wait);
 bool      ioRunCommandPrintf(const char *fmt, ...);
+bool      ioRunCommandFile(const char *name, bool wait);
+
+void      logLoop();
+uint16_t  logDump(Stream *out, uint8_t level);
 
+void      storageSelect(const struct storageBackend_s *backend);
 bool      filesysInit();
 void      filesysLoop();
 bool      filesysExists(const char *name);
 void      filesysDelete(const char *name);
 File      filesysOpen(const char *name, const char *mode);
 void      filesysClose(File handle);
+void      filesysSync();
+bool      filesysCacheSetup(uint16_t pages, bool psram);
+int       filesysCacheStats(char *text, size_t size);
 char      *filesysGetFileInfo(bool first, bool hidden);
+void      filesysDirBegin(struct filesysDir_s *dir, const char *pattern, bool show_hidden);
+bool      filesysDirNext(struct filesysDir_s *dir, struct filesysEntry_s *entry);
+void      filesysDirEnd(struct filesysDir_s *dir);
+int       filesysFormatEntry(const struct filesysEntry_s *entry, char *buf, size_t size);
+bool      filesysGlobMatch(const char *pattern, const char *name);
 uint8_t   filesysGetType(const char *name);
-uint8_t   filesysReadHex(Stream *handle);
+uint8_t   filesysReadHex(Stream *handle, struct hexDecoder_s *hex);
 uint16_t  streamReadLine(Stream *handle, char *buf, uint16_t size, bool escaped_characters);
+uint16_t  streamReadLine(File *handle, char *buf, uint16_t size, bool escaped_characters);
+int32_t   filesysGetSize(const char *name);
 bool      filesysSaveStart(const char *name);
+bool      filesysSaveStartAt(const char *name, uint32_t offset);
+size_t    filesysSaveWritable();
 bool      filesysSaveWrite(uint8_t *buf, size_t size);
 bool      filesysSaveFinish();
+bool      filesysGetDigest(const char *name, char *text, size_t size);
+bool      filesysComputeDigest(const char *name, char *text, size_t size);
+bool      filesysCanDigest(const char *name);
 
 #include "allincludes.h"
 
 static WiFiMulti wifiMulti; // Create an instance of the WiFiMulti class, called 'wifiMulti'
 
-static WiFiServer g_tcp_server(TCP_PORT); // TODO need a more secure option
+static WiFiServer g_tcp_server(TCP_PORT, TCP_MAX_CLIENTS); // TODO need a more secure option
 #ifdef ALLOW_TELNET
   static WiFiServer g_telnet_server(TELNET_PORT); // TODO need a more secure option
 #endif
-// we only support one client (of each type) at a time
+// there is one telnet client at a time as it is bridged to the one UART; there are TCP_MAX_CLIENTS TCP clients
 #ifdef ALLOW_TELNET
   static WiFiClient g_telnet_client;
+  static parserSession_t g_telnet_session;  // active while the telnet client is redirected to the parser
+  static uint32_t g_telnet_deadline;
+#endif
+
+typedef struct
+{
+  WiFiClient client;
+  parserSession_t session;                  // active while the slot is in use
+  uint32_t deadline;                        // the session ends when no data arrives before this time
+  bool more;                                // input is buffered or output is pending; poll without waiting for the socket
+  uint8_t out_buf[CORK_SIZE];               // the output of the session is collected here
+} tcpConnection_t;
+
+static tcpConnection_t g_tcp_pool[TCP_MAX_CLIENTS];
+static uint8_t g_tcp_turn;                  // the slot which is served first by the next loop
+
+// the sockets are watched with select(); a socket of -1 can not be watched and is polled on every loop
+static int g_tcp_listen_fd = -1;
+#ifdef ALLOW_TELNET
+  static int g_telnet_listen_fd = -1;
+  static bool g_telnet_more;
 #endif
+static fd_set g_wifi_readable;              // the sockets which select() found ready on this loop
+static bool g_wifi_poll_all;                // select() failed; every socket is treated as ready
 
-static WiFiClient g_tcp_client;
+static parserSession_t g_serial_session;
+static uint32_t g_serial_deadline;
 
 //--------------------------------------------------------------------------
-static void wifi_handle_tcp_requests()
+static bool deadline_passed(uint32_t deadline)
 {
-  // handle any connection requests
-  // we only support one telnet connect at a time; a second one is ejected
-  if (g_tcp_server.hasClient())
+  return ((int32_t)(millis() - deadline) >= 0);
+
+} //  deadline_passed()
+
+
+//--------------------------------------------------------------------------
+// the WiFiServer does not expose its socket; find the one which listens on the port
+static int wifi_listen_socket(uint16_t port)
+{
+  for (int fd = LWIP_SOCKET_OFFSET; fd < FD_SETSIZE; fd++)
   {
-    DEBUGSERIAL.println("tcp client requested");
-    if (g_tcp_client) g_tcp_client.stop();
-    g_tcp_client = g_tcp_server.available();
+    int listening = 0;
+    socklen_t len = sizeof(listening);
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) || !listening)
+      continue;
+    if (!getsockname(fd, (struct sockaddr *)&addr, &addr_len) && (addr.sin_family == AF_INET) && (ntohs(addr.sin_port) == port))
+      return fd;
   }
-  else
+  DEBUG("no socket for port %u; it is polled\n", port);
+  return -1;
+
+} //  wifi_listen_socket()
+
+
+//--------------------------------------------------------------------------
+static bool wifi_ready(int fd)
+{
+  return (fd < 0) || g_wifi_poll_all || FD_ISSET(fd, &g_wifi_readable);
+
+} //  wifi_ready()
+
+
+//--------------------------------------------------------------------------
+static void wifi_watch(int fd, int *max_fd)
+{
+  if ((fd < 0) || (fd >= FD_SETSIZE))
+    return;
+  FD_SET(fd, &g_wifi_readable);
+  if (fd > *max_fd)
+    *max_fd = fd;
+
+} //  wifi_watch()
+
+
+//--------------------------------------------------------------------------
+static void wifi_wait_until(uint32_t deadline, uint32_t *wait)
+{
+  int32_t left = (int32_t)(deadline - millis());
+  if (left < 0)
+    left = 0;
+  if ((uint32_t)left < *wait)
+    *wait = left;
+
+} //  wifi_wait_until()
+
+
+//--------------------------------------------------------------------------
+/*
+  this is where loop() sleeps. select() returns as soon as a connection request or data arrives,
+  otherwise at the first session deadline or after WIFI_IDLE_WAIT. an idle connection is a bit
+  in the fd_set; its WiFiClient is not touched until its socket is ready or its deadline passes.
+*/
+static void wifi_wait_for_sockets()
+{
+  uint32_t wait = WIFI_IDLE_WAIT;
+  int max_fd = -1;
+
+  FD_ZERO(&g_wifi_readable);
+  wifi_watch(g_tcp_listen_fd, &max_fd);
+  for (uint8_t i = 0; i < TCP_MAX_CLIENTS; i++)
   {
-    // we lost the connection
-    if (g_tcp_client && !g_tcp_client.connected())
-    {
-      g_tcp_client.stop();
-      DEBUGSERIAL.println("tcp client stopped");
-      return;
-    }
+    tcpConnection_t *conn = &(g_tcp_pool[i]);
+    if (!conn->session.client)
+      continue;
+    wifi_watch(conn->client.fd(), &max_fd);
+    wifi_wait_until(conn->deadline, &wait);
+    if (conn->more && (wait > WIFI_BUSY_WAIT))
+      wait = WIFI_BUSY_WAIT;
   }
+#ifdef ALLOW_TELNET
+  wifi_watch(g_telnet_listen_fd, &max_fd);
+  if (g_telnet_client)
+    wifi_watch(g_telnet_client.fd(), &max_fd);
+  if (g_telnet_session.client)
+    wifi_wait_until(g_telnet_deadline, &wait);
+  if (g_telnet_more && (wait > WIFI_BUSY_WAIT))
+    wait = WIFI_BUSY_WAIT;
+#endif
+  if (g_serial_session.client)
+    wifi_wait_until(g_serial_deadline, &wait);
+  if (parserSessionBusy(&g_serial_session) && (wait > WIFI_BUSY_WAIT))
+    wait = WIFI_BUSY_WAIT;
+
+  struct timeval timeout;
+  timeout.tv_sec = 0;
+  timeout.tv_usec = wait * 1000;
+  g_wifi_poll_all = (select(max_fd + 1, &g_wifi_readable, NULL, NULL, &timeout) < 0);
+  if (g_wifi_poll_all)
+    delay(WIFI_BUSY_WAIT);
+
+} //  wifi_wait_for_sockets()
+
+
+//--------------------------------------------------------------------------
+static void wifi_serve_tcp_client(tcpConnection_t *conn)
+{
+  if (!conn->session.client)
+    return;
 
-  if (g_tcp_client && g_tcp_client.connected())
+  //-- a connection which is not ready only checks its deadline
+  bool ready = conn->more || wifi_ready(conn->client.fd());
+  if (ready && (conn->client.available() || parserSessionBusy(&(conn->session))))
   {
-    uint32_t timeout = millis() + TCP_TIMEOUT;
-    while (millis() < timeout)
+    //-- take what has arrived and send pending output; a partial command is continued on the next loop
+    parserSessionPoll(&(conn->session));
+    conn->deadline = millis() + (parserSessionKeepAlive(&(conn->session)) ? TCP_KEEPALIVE_TIMEOUT : TCP_IDLE_TIMEOUT);
+    conn->more = conn->client.available() || parserSessionBusy(&(conn->session));
+    return;
+  }
+  conn->more = false;
+
+  //-- the batch is complete once the client closes its side or stays silent until the deadline
+  if ((!ready || conn->client.connected()) && !deadline_passed(conn->deadline))
+    return;
+
+  parserSessionEnd(&(conn->session));
+  // unless the client asked for KEEPALIVE we operate in single command/response mode, so we close the client session
+  conn->client.stop();
+  DEBUG("tcp client stopped\n");
+
+} //  wifi_serve_tcp_client()
+
+
+//--------------------------------------------------------------------------
+static void wifi_handle_tcp_requests()
+{
+  // handle any connection requests
+  // a new client takes a free slot of the pool; when all slots are in use it is turned away
+  while (wifi_ready(g_tcp_listen_fd) && g_tcp_server.hasClient())
+  {
+    DEBUG("tcp client requested\n");
+    WiFiClient client = g_tcp_server.available();
+    tcpConnection_t *conn = NULL;
+    for (uint8_t i = 0; (i < TCP_MAX_CLIENTS) && !conn; i++)
     {
-      if (g_tcp_client.available())
-        break;
+      if (!g_tcp_pool[i].session.client)
+        conn = &(g_tcp_pool[i]);
     }
-    if (millis() >= timeout)
+    if (!conn)
     {
-      // we timed out
-      DEBUGSERIAL.println("TCP Client Timeout");
-      g_tcp_client.stop();
-      return;
+      client.print("Error: too many clients\n");
+      client.stop();
+      continue;
     }
+    conn->client = client;
+    conn->more = false;
     // TCP processing is handed off to the parser subsystem
-    parserProcessCommands((Stream *) (&g_tcp_client), false);
+    parserSessionBegin(&(conn->session), (Stream *)(&(conn->client)), false, conn->out_buf);
+    conn->deadline = millis() + TCP_TIMEOUT;
   }
-  // since we operate in single command/response mode, we can close the client session
-  g_tcp_client.stop();
-  
+
+  //-- every connection gets one poll per loop; the first one changes from loop to loop
+  for (uint8_t i = 0; i < TCP_MAX_CLIENTS; i++)
+    wifi_serve_tcp_client(&(g_tcp_pool[(g_tcp_turn + i) % TCP_MAX_CLIENTS]));
+  g_tcp_turn = (g_tcp_turn + 1) % TCP_MAX_CLIENTS;
+
 } //  wifi_handle_tcp_requests()
 
 
@@ -162,6 +343,7 @@ static bool wifi_start_tcp_server()
   // Start Telnet server
   g_tcp_server.begin(TCP_PORT);
   g_tcp_server.setNoDelay(true);
+  g_tcp_listen_fd = wifi_listen_socket(TCP_PORT);
   return true;
 
 } //  wifi_start_tcp_server()
@@ -174,6 +356,7 @@ static bool wifi_start_telnet_server()
   // Start Telnet server
   g_telnet_server.begin();
   g_telnet_server.setNoDelay(true);
+  g_telnet_listen_fd = wifi_listen_socket(TELNET_PORT);
   return true;
   
 } //  wifi_start_telnet_server()
@@ -181,42 +364,63 @@ static bool wifi_start_telnet_server()
 
 static void wifi_handle_telnet_requests()
 {
-  memset(g_network_buf, 0, (MAX_NETWORK_TEXT + 1 + 1));
   // the telnet connection interfaces to the CHIPSERIAL UART
+  bool ready = g_telnet_client && (g_telnet_more || wifi_ready(g_telnet_client.fd()));
 
   // handle any connection requests
   // we only support one telnet connect at a time; a second one is ejected
-  if (g_telnet_server.hasClient())
+  if (wifi_ready(g_telnet_listen_fd) && g_telnet_server.hasClient())
   {
-    DEBUGSERIAL.println("telnet client requester");
+    DEBUG("telnet client requester\n");
+    if (g_telnet_session.client)
+      parserSessionEnd(&g_telnet_session);
     if (g_telnet_client)
       g_telnet_client.stop();
     g_telnet_client = g_telnet_server.available();
+    ready = true;
   }
   else
   {
     // we lost the connection
-    if (g_telnet_client && !g_telnet_client.connected())
+    if (ready && !g_telnet_client.connected())
       g_telnet_client.stop();
   }
+  g_telnet_more = false;
+
+  //-- while redirected, everything from the telnet client goes to the parser
+  //-- until the user stops typing for TCP_TIMEOUT
+  if (g_telnet_session.client)
+  {
+    if ((ready && g_telnet_client.available()) || parserSessionBusy(&g_telnet_session))
+    {
+      parserSessionPoll(&g_telnet_session);
+      g_telnet_deadline = millis() + TCP_TIMEOUT;
+      g_telnet_more = g_telnet_client.available() || parserSessionBusy(&g_telnet_session);
+    }
+    else if (!g_telnet_client || deadline_passed(g_telnet_deadline))
+    {
+      parserSessionEnd(&g_telnet_session);
+    }
+    return;
+  }
 
   //--  a little trick: if the first character is a backslash, then we 
   //-- redirect the telnet to the parser command process
-  if (g_telnet_client.available() && (g_telnet_client.peek() == '\\'))
+  if (ready && g_telnet_client.available() && (g_telnet_client.peek() == '\\'))
   {
     g_telnet_client.read(); // throw away the back slash
-    delay(1000);
     /*
-      OK, this is a huge kludge.
-      we delay so the user has time to compose and send the command(s).
-      they (I) had better type quick .. or use cut/paste ;-)
+      the user has TCP_TIMEOUT between keystrokes to compose and send the command(s).
+      the session picks up whatever arrives on the following loops so we do not wait here
     */
-    parserProcessCommands((Stream *)(&g_telnet_client), false);
+    parserSessionBegin(&g_telnet_session, (Stream *)(&g_telnet_client), false);
+    g_telnet_deadline = millis() + TCP_TIMEOUT;
+    g_telnet_more = true;
     return;
   }
 
   // Get data from the telnet client and push it to the UART
-  while (g_telnet_client.available())
+  while (ready && g_telnet_client.available())
   {
     CHIPSERIAL.write(g_telnet_client.read());
   }
@@ -224,6 +428,7 @@ static void wifi_handle_telnet_requests()
   // get any data from UART and push it to telnet client
   if (CHIPSERIAL.available())
   {
+    memset(g_network_buf, 0, (MAX_NETWORK_TEXT + 1 + 1));
     size_t len = CHIPSERIAL.available();
 
     if (len > MAX_NETWORK_TEXT)
@@ -266,15 +471,24 @@ Give the WiFi services an opportunity to respond to any necessary actions
 --- */
 void wifiLoop()
 {
+  wifi_wait_for_sockets();
+
 #ifdef ALLOW_TELNET
   wifi_handle_telnet_requests();
 #endif
 
   wifi_handle_tcp_requests();
   
-  if (Serial.available())
+  if (Serial.available() || parserSessionBusy(&g_serial_session))
+  {
+    if (!g_serial_session.client)
+      parserSessionBegin(&g_serial_session, &Serial, false);
+    parserSessionPoll(&g_serial_session);
+    g_serial_deadline = millis() + TCP_IDLE_TIMEOUT;
+  }
+  else if (g_serial_session.client && deadline_passed(g_serial_deadline))
   {
-    parserProcessCommands(&Serial, false);
+    parserSessionEnd(&g_serial_session);
   }
   
 } //  wifiLoop()
@@ -358,7 +572,8 @@ void loop()
   filesysLoop();
   //parserLoop();
   ioLoop();
-  delay(1);
+  logLoop();
+  // wifiLoop() sleeps in select() until a socket is ready
 
 } //  loop()
 
@@ -0,0 +1,250 @@
+#ifndef __DIGEST_H
+#define __DIGEST_H
+
+/* ***************************************************************************
+* File:    digest
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### DIGEST API
+
+Incremental digests of file content. The CRC32 (the zlib/PNG polynomial) is always computed;
+it uses the slice-by-8 method which handles 8 bytes per step with eight 1 KB lookup tables.
+The tables are built by the first digestBegin(). When `DIGEST_SHA256` is defined, a SHA-256 is computed
+over the same data.
+
+The digest text has the form `CRC32=xxxxxxxx SIZE=n SHA256=xxxx...`.
+
+_NOTE: The slice-by-8 kernel assumes a little endian CPU, which the ESP32 is._
+--- */
+
+#define DIGEST_SHA256   // uploads also get a SHA-256; comment out to only compute the CRC32
+#define DIGEST_TEXT_LEN 120
+
+typedef struct
+{
+  uint32_t crc;
+  uint32_t size;
+#ifdef DIGEST_SHA256
+  uint32_t sha_state[8];
+  uint8_t sha_block[64];
+  uint64_t sha_bits;
+  uint8_t sha_fill;
+#endif
+} digest_t;
+
+static uint32_t _digest_crc_table[8][256];
+static bool _digest_crc_ready = false; // only the task which calls digestBegin() builds the tables
+
+
+// -------- CRC32 --------------------------------------------------------------------
+
+static void _digestCrcTables()
+{
+  for (uint32_t i = 0; i < 256; i++)
+  {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320UL : 0);
+    _digest_crc_table[0][i] = crc;
+  }
+  //-- table n gives the CRC of a byte followed by n zero bytes
+  for (int n = 1; n < 8; n++)
+    for (int i = 0; i < 256; i++)
+      _digest_crc_table[n][i] = (_digest_crc_table[n - 1][i] >> 8) ^ _digest_crc_table[0][_digest_crc_table[n - 1][i] & 0xFF];
+  _digest_crc_ready = true;
+}
+
+/* ---
+#### digestCrc32()
+
+The tables are built by the first digestBegin(). It runs on the loop task before an upload
+hands data to the pipeline writer, so the writer only ever reads complete tables.
+
+- input: crc **uint32_t** the CRC of the preceding data; 0 to start
+- input: buf **uint8_t ptr** the data
+- input: len **size_t** the number of bytes
+- return: **uint32_t** the CRC including the data
+--- */
+uint32_t digestCrc32(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  crc = ~crc;
+  while (len >= 8)
+  {
+    uint32_t one, two;
+    memcpy(&one, buf, 4);
+    memcpy(&two, buf + 4, 4);
+    one ^= crc;
+    crc = _digest_crc_table[7][one & 0xFF] ^ _digest_crc_table[6][(one >> 8) & 0xFF] ^
+          _digest_crc_table[5][(one >> 16) & 0xFF] ^ _digest_crc_table[4][one >> 24] ^
+          _digest_crc_table[3][two & 0xFF] ^ _digest_crc_table[2][(two >> 8) & 0xFF] ^
+          _digest_crc_table[1][(two >> 16) & 0xFF] ^ _digest_crc_table[0][two >> 24];
+    buf += 8;
+    len -= 8;
+  }
+  while (len--)
+    crc = _digest_crc_table[0][(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+
+// -------- SHA-256 --------------------------------------------------------------------
+#ifdef DIGEST_SHA256
+
+static const uint32_t _digest_sha_k[64] =
+{
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define _DIGEST_ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void _digestShaBlock(digest_t *digest, const uint8_t *block)
+{
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++)
+    w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) | ((uint32_t)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+  for (int i = 16; i < 64; i++)
+  {
+    uint32_t s0 = _DIGEST_ROR(w[i - 15], 7) ^ _DIGEST_ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = _DIGEST_ROR(w[i - 2], 17) ^ _DIGEST_ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = digest->sha_state[0], b = digest->sha_state[1], c = digest->sha_state[2], d = digest->sha_state[3];
+  uint32_t e = digest->sha_state[4], f = digest->sha_state[5], g = digest->sha_state[6], h = digest->sha_state[7];
+  for (int i = 0; i < 64; i++)
+  {
+    uint32_t t1 = h + (_DIGEST_ROR(e, 6) ^ _DIGEST_ROR(e, 11) ^ _DIGEST_ROR(e, 25)) + ((e & f) ^ (~e & g)) + _digest_sha_k[i] + w[i];
+    uint32_t t2 = (_DIGEST_ROR(a, 2) ^ _DIGEST_ROR(a, 13) ^ _DIGEST_ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  digest->sha_state[0] += a;
+  digest->sha_state[1] += b;
+  digest->sha_state[2] += c;
+  digest->sha_state[3] += d;
+  digest->sha_state[4] += e;
+  digest->sha_state[5] += f;
+  digest->sha_state[6] += g;
+  digest->sha_state[7] += h;
+}
+
+static void _digestShaUpdate(digest_t *digest, const uint8_t *buf, size_t len)
+{
+  digest->sha_bits += (uint64_t)len * 8;
+  while (len)
+  {
+    if (!digest->sha_fill && (len >= 64))
+    {
+      //-- whole blocks are taken straight from the caller's buffer
+      _digestShaBlock(digest, buf);
+      buf += 64;
+      len -= 64;
+      continue;
+    }
+    size_t count = 64 - digest->sha_fill;
+    if (count > len)
+      count = len;
+    memcpy(digest->sha_block + digest->sha_fill, buf, count);
+    digest->sha_fill += count;
+    buf += count;
+    len -= count;
+    if (digest->sha_fill == 64)
+    {
+      _digestShaBlock(digest, digest->sha_block);
+      digest->sha_fill = 0;
+    }
+  }
+}
+
+#endif
+
+
+/* ---
+#### digestBegin()
+
+- input: digest **digest_t ptr** the digest storage; it is owned by the caller
+--- */
+void digestBegin(digest_t *digest)
+{
+  if (!_digest_crc_ready)
+    _digestCrcTables();
+
+  digest->crc = 0;
+  digest->size = 0;
+#ifdef DIGEST_SHA256
+  static const uint32_t init[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  memcpy(digest->sha_state, init, sizeof(init));
+  digest->sha_bits = 0;
+  digest->sha_fill = 0;
+#endif
+}
+
+/* ---
+#### digestUpdate()
+
+- input: digest **digest_t ptr** a digest
+- input: buf **uint8_t ptr** the next part of the data
+- input: len **size_t** the number of bytes
+--- */
+void digestUpdate(digest_t *digest, const uint8_t *buf, size_t len)
+{
+  digest->crc = digestCrc32(digest->crc, buf, len);
+  digest->size += len;
+#ifdef DIGEST_SHA256
+  _digestShaUpdate(digest, buf, len);
+#endif
+}
+
+/* ---
+#### digestFinish()
+
+The padding of SHA-256 goes through the state, so the digest starts over afterwards:
+it is as digestBegin() leaves it.
+
+- input: digest **digest_t ptr** a digest
+- input: text **char ptr** storage for the digest text; DIGEST_TEXT_LEN is enough
+- input: size **size_t** the size of the storage
+--- */
+void digestFinish(digest_t *digest, char *text, size_t size)
+{
+  int len = snprintf(text, size, "CRC32=%08X SIZE=%u", digest->crc, digest->size);
+
+#ifdef DIGEST_SHA256
+  //-- the padding is a 1 bit, zeros up to 56 bytes of the block and the bit count
+  uint64_t bits = digest->sha_bits;
+  uint8_t pad[64 + 8] = {0x80};
+  size_t count = ((digest->sha_fill < 56) ? 56 : 120) - digest->sha_fill;
+  for (int i = 0; i < 8; i++)
+    pad[count + i] = bits >> (56 - (i * 8));
+  _digestShaUpdate(digest, pad, count + 8);
+
+  if ((len > 0) && ((size_t)len < size))
+    len += snprintf(text + len, size - len, " SHA256=");
+  for (int i = 0; (i < 8) && (len > 0) && ((size_t)len < size); i++)
+    len += snprintf(text + len, size - len, "%08x", digest->sha_state[i]);
+#endif
+  digestBegin(digest);
+}
+
+#endif
+
+/*eof*/
@@ -3,6 +3,11 @@
 
 //#define MAX_FILENAME_LEN 32
 #define MAX_FORMATBYTES 10
+#define FILESYS_BLOCK_SIZE 4096 // uploads are written to flash in blocks of this size
+#define FILESYS_UPLOAD_PIPELINE // uploads are written to flash by the pipeline writer while the next block is received
+#define FILESYS_CACHE_PAGE_SIZE 512          // the unit of the write-back cache
+#define FILESYS_CACHE_PAGES     8            // the default size of the cache in pages; see filesysCacheSetup()
+#define FILESYS_CACHE_LOW_HEAP  (16 * 1024)  // with less free heap the cache is written and released
 
 #define FILE_TYPE_UNKN  0
 #define FILE_TYPE_CMD 1
@@ -22,14 +27,30 @@ bool filesysExists(const char* name);
 void filesysDelete(const char *name);
 File filesysOpen(const char *name, const char* mode);
 void filesysClose(File handle);
+void filesysSync();
+bool filesysCacheSetup(uint16_t pages, bool psram);
+int filesysCacheStats(char *text, size_t size);
 char *filesysGetFileInfo(bool first, bool hidden);
+void filesysDirBegin(filesysDir_t *dir, const char *pattern, bool show_hidden);
+bool filesysDirNext(filesysDir_t *dir, filesysEntry_t *entry);
+void filesysDirEnd(filesysDir_t *dir);
+int filesysFormatEntry(const filesysEntry_t *entry, char *buf, size_t size);
+bool filesysGlobMatch(const char *pattern, const char *name);
 uint8_t filesysGetType(const char *name);
-uint8_t filesysReadHex(Stream *handle);
+uint8_t filesysReadHex(Stream *handle, hexDecoder_t *hex);
 uint16_t streamReadLine(Stream* handle, char *buf, uint16_t size, bool escaped_characters);
+uint16_t streamReadLine(File* handle, char *buf, uint16_t size, bool escaped_characters);
 
+int32_t filesysGetSize(const char *name);
 bool filesysSaveStart(const char* name);
+bool filesysSaveStartAt(const char* name, uint32_t offset);
+size_t filesysSaveWritable();
 bool filesysSaveWrite(uint8_t* buf, size_t size);
 bool filesysSaveFinish();
+
+bool filesysGetDigest(const char *name, char *text, size_t size);
+bool filesysComputeDigest(const char *name, char *text, size_t size);
+bool filesysCanDigest(const char *name);
 */
 
 /* ***************************************************************************
@@ -46,7 +67,8 @@ bool filesysSaveFinish();
 --------------------------------------------------------------------------
 ### FILESYS API
 
-Provide access to the SPIFFS file system.
+Provide access to the SPIFFS file system. The files are reached through a storage backend (see storage.h)
+which is the SPIFFS on the ESP32 and a plain directory on a host.
 
 The SPIFFS flash interface is handled by the combination of the display and the UI button(s).
 
@@ -56,18 +78,370 @@ The `TTGOT4` uses 3 buttons for navigation and selection.
 
 The 'TTGO18650' used a 1-button interface with short presses for navigation and long presses for selection.
 
+The names, sizes and types of all files are kept in a RAM index which is built once by filesysInit()
+and kept up to date by the upload, delete and close functions. filesysExists(), filesysGetSize() and
+the directory listing answer from the index without touching the flash.
+
+A directory listing uses a cursor which is owned by the caller, so any number of listings may be
+in progress. filesysDirBegin() takes an optional glob pattern (`*` and `?`, case insensitive);
+filesysDirNext() copies the next matching entry to the caller and filesysFormatEntry() turns it
+into a line of text in the caller's buffer. The cursor remembers the last name it returned and
+continues after it, so files may be added or deleted while a listing is in progress.
+filesysGetFileInfo() is the older interface; it shares a single cursor and a static buffer.
+
+Small writes go through a write-back cache of FILESYS_CACHE_PAGE_SIZE pages which is shared by all
+files that filesysOpen() opens for writing, the digest sidecars and - without the upload pipeline - the
+uploads. Writes to the same page are merged; a write which covers whole pages goes straight to the storage.
+The pages of a file are written in order when the file is closed or flushed, when filesysSync() is
+called, when the page is needed for another file and when the free heap drops below FILESYS_CACHE_LOW_HEAP.
+The pipeline writer task writes whole blocks on its own and does not use the cache.
+
+Every upload gets a digest (see digest.h) which is computed while the data is written
+and stored in a hidden sidecar file `.<name>.sum`. The sidecar follows the file when it is deleted.
+A name which leaves no room for the sidecar name within MAX_FILENAME_LEN gets no digest;
+filesysCanDigest() tells the caller so it can report it.
+
 The **HEXFILE API** provides a series of functions for handling Intel HEX file format and uses Stream I/O
 to handle both FILE operations and Stream data with the TCP connection.
+filesysReadHex() feeds a Stream to a decoder (see hexfile.h) in chunks.
 --- */
 
 
 
 // local includes
 #include "allincludes.h"
+#include <FSImpl.h>
 
 static File _filesys_upload_file; // a File variable to temporarily store the received file
 static int _filesys_upload_size = 0;
-static File _spiffs_dir; // the directory list
+static digest_t _filesys_upload_digest;
+static char _filesys_upload_name[MAX_FILENAME_LEN + 1];
+#ifdef FILESYS_UPLOAD_PIPELINE
+static pipeline_t _filesys_upload_pipe;
+#else
+static uint8_t _filesys_upload_block[FILESYS_BLOCK_SIZE]; // the partial block of the upload
+static size_t _filesys_upload_fill = 0;
+#endif
+typedef struct filesysEntry_s
+{
+  char name[MAX_FILENAME_LEN + 1]; // the full name with the leading '/'
+  uint32_t size;
+  uint8_t type;                    // FILE_TYPE_xxx
+} filesysEntry_t;
+
+typedef struct filesysDir_s
+{
+  char pattern[MAX_FILENAME_LEN + 1]; // empty to list every file
+  bool show_hidden;                   // without a pattern; a pattern must start with '.' to match hidden files
+  char last[MAX_FILENAME_LEN + 1];    // the name last returned; empty before the first entry
+  bool done;                          // the end of the listing has been reached
+  File storage_dir;                   // only used when there is no index
+} filesysDir_t;
+
+static filesysEntry_t *_filesys_index = NULL; // sorted by name
+static uint16_t _filesys_index_count = 0;
+static uint16_t _filesys_index_room = 0;
+static bool _filesys_index_ready = false;    // without an index every lookup goes to the storage
+
+// -------- write-back cache --------------------------------------------------------------------
+
+class filesysCacheFile;
+
+typedef struct
+{
+  filesysCacheFile *owner;   // NULL when the page is free
+  uint32_t page;             // the page number within the file
+  uint16_t lo;               // the dirty bytes are lo .. hi - 1
+  uint16_t hi;
+  uint32_t last_used;
+  uint8_t *data;
+} filesysCachePage_t;
+
+typedef struct
+{
+  uint32_t writes;           // write calls
+  uint32_t merged;           // writes which went to a page which was already cached
+  uint32_t flash_writes;     // writes passed on to the storage
+} filesysCacheStats_t;
+
+static filesysCachePage_t *_filesys_cache = NULL;
+static uint8_t *_filesys_cache_data = NULL;
+static uint16_t _filesys_cache_count = 0;                 // pages allocated; 0 until the cache is first used
+static uint16_t _filesys_cache_room = FILESYS_CACHE_PAGES; // pages to allocate; 0 disables the cache
+static bool _filesys_cache_psram = true;
+static uint32_t _filesys_cache_clock = 0;
+static filesysCacheStats_t _filesys_cache_stats;
+
+static filesysCachePage_t *_filesys_cache_take();
+
+// a File of the storage with its small writes held in the cache
+class filesysCacheFile : public fs::FileImpl
+{
+private:
+  File file;
+  uint32_t pos;
+  uint32_t end;  // the size including the cached data
+  bool append;
+  uint16_t cached; // pages of the cache held by this file
+
+  bool writeThrough(uint32_t offset, const uint8_t *buf, size_t len)
+  {
+    _filesys_cache_stats.flash_writes++;
+    if ((file.position() != offset) && !append && !file.seek(offset))
+      return false;
+    return file.write(buf, len) == len;
+  }
+
+  filesysCachePage_t *findPage(uint32_t page)
+  {
+    for (uint16_t i = 0; cached && (i < _filesys_cache_count); i++)
+      if ((_filesys_cache[i].owner == this) && (_filesys_cache[i].page == page))
+        return &(_filesys_cache[i]);
+    return NULL;
+  }
+
+public:
+  filesysCacheFile(File f, const char *mode) : file(f)
+  {
+    append = (mode[0] == 'a');
+    end = file.size();
+    pos = append ? end : file.position();
+    cached = 0;
+  }
+
+  ~filesysCacheFile()
+  {
+    close();
+  }
+
+  // write the cached pages of the file in order; the file stays contiguous and there is no seek between adjacent pages
+  bool sync()
+  {
+    bool success = true;
+    while (cached)
+    {
+      filesysCachePage_t *first = NULL;
+      for (uint16_t i = 0; i < _filesys_cache_count; i++)
+        if ((_filesys_cache[i].owner == this) && (!first || (_filesys_cache[i].page < first->page)))
+          first = &(_filesys_cache[i]);
+      if (!first)
+        break;
+      if (!writeThrough((first->page * FILESYS_CACHE_PAGE_SIZE) + first->lo, first->data + first->lo, first->hi - first->lo))
+        success = false;
+      first->owner = NULL;
+      cached--;
+    }
+    cached = 0;
+    return success;
+  }
+
+  size_t write(const uint8_t *buf, size_t size)
+  {
+    if (!file)
+      return 0;
+    if (append)
+      pos = end;
+    _filesys_cache_stats.writes++;
+
+    size_t done = 0;
+    while (done < size)
+    {
+      uint32_t page = pos / FILESYS_CACHE_PAGE_SIZE;
+      uint16_t offset = pos % FILESYS_CACHE_PAGE_SIZE;
+      size_t len = FILESYS_CACHE_PAGE_SIZE - offset;
+      if (len > (size - done))
+        len = size - done;
+
+      filesysCachePage_t *cp = findPage(page);
+      //-- a write which does not touch the dirty bytes of the page can not be merged
+      if (cp && ((offset > cp->hi) || ((offset + len) < cp->lo)))
+      {
+        sync();
+        cp = NULL;
+      }
+      if (!cp && !offset && (len == FILESYS_CACHE_PAGE_SIZE))
+      {
+        //-- whole pages go straight to the storage after the cached data which comes before them
+        len = (size - done) - ((size - done) % FILESYS_CACHE_PAGE_SIZE);
+        sync();
+      }
+      else if (cp)
+        _filesys_cache_stats.merged++;
+      else if ((cp = _filesys_cache_take()))
+      {
+        cp->owner = this;
+        cp->page = page;
+        cp->lo = offset;
+        cp->hi = offset;
+        cached++;
+      }
+      else
+        sync(); // without a cache the data goes straight to the storage
+
+      if (cp)
+      {
+        memcpy(cp->data + offset, buf + done, len);
+        if (offset < cp->lo)
+          cp->lo = offset;
+        if ((offset + len) > cp->hi)
+          cp->hi = offset + len;
+        cp->last_used = ++_filesys_cache_clock;
+      }
+      else if (!writeThrough(pos, buf + done, len))
+        break;
+      pos += len;
+      done += len;
+      if (pos > end)
+        end = pos;
+    }
+    return done;
+  }
+
+  size_t read(uint8_t *buf, size_t size)
+  {
+    if (!file)
+      return 0;
+    sync();
+    if ((file.position() != pos) && !file.seek(pos))
+      return 0;
+    size_t count = file.read(buf, size);
+    if (count != (size_t)-1)
+      pos += count;
+    return count;
+  }
+
+  void flush()
+  {
+    sync();
+    if (file)
+      file.flush();
+  }
+
+  bool seek(uint32_t offset, SeekMode mode)
+  {
+    uint32_t base = (mode == SeekSet) ? 0 : (mode == SeekCur) ? pos : end;
+    if ((base + offset) > end)
+      return false;
+    pos = base + offset;
+    return true;
+  }
+
+  size_t position() const
+  {
+    return pos;
+  }
+
+  size_t size() const
+  {
+    return end;
+  }
+
+  bool setBufferSize(size_t size)
+  {
+    return true;
+  }
+
+  void close()
+  {
+    if (!file)
+      return;
+    sync();
+    file.close();
+  }
+
+  time_t getLastWrite()
+  {
+    return file.getLastWrite();
+  }
+
+  const char *path() const
+  {
+    return file.path();
+  }
+
+  const char *name() const
+  {
+    return file.name();
+  }
+
+  boolean isDirectory(void)
+  {
+    return false;
+  }
+
+  fs::FileImplPtr openNextFile(const char *mode)
+  {
+    return fs::FileImplPtr();
+  }
+
+  void rewindDirectory(void)
+  {
+  }
+
+  operator bool()
+  {
+    return (bool)file;
+  }
+};
+
+static void _filesys_cache_release()
+{
+  // every page is written and the memory is returned; the cache is allocated again when it is needed
+  for (uint16_t i = 0; i < _filesys_cache_count; i++)
+    if (_filesys_cache[i].owner)
+      _filesys_cache[i].owner->sync();
+  free(_filesys_cache_data);
+  free(_filesys_cache);
+  _filesys_cache_data = NULL;
+  _filesys_cache = NULL;
+  _filesys_cache_count = 0;
+}
+
+static bool _filesys_cache_alloc()
+{
+  size_t size = _filesys_cache_room * FILESYS_CACHE_PAGE_SIZE;
+  if (!_filesys_cache_room || (ESP.getFreeHeap() < (FILESYS_CACHE_LOW_HEAP + size)))
+    return false;
+  _filesys_cache = (filesysCachePage_t *)calloc(_filesys_cache_room, sizeof(filesysCachePage_t));
+  if (_filesys_cache_psram && (ESP.getFreePsram() > size))
+    _filesys_cache_data = (uint8_t *)ps_malloc(size);
+  if (!_filesys_cache_data)
+    _filesys_cache_data = (uint8_t *)malloc(size);
+  if (!_filesys_cache || !_filesys_cache_data)
+  {
+    _filesys_cache_release();
+    return false;
+  }
+  for (uint16_t i = 0; i < _filesys_cache_room; i++)
+    _filesys_cache[i].data = _filesys_cache_data + (i * FILESYS_CACHE_PAGE_SIZE);
+  _filesys_cache_count = _filesys_cache_room;
+  return true;
+}
+
+// a free page; when there is none the pages of the file with the least recently used page are written
+static filesysCachePage_t *_filesys_cache_take()
+{
+  if (!_filesys_cache_count && !_filesys_cache_alloc())
+    return NULL;
+
+  filesysCachePage_t *oldest = NULL;
+  for (uint16_t i = 0; i < _filesys_cache_count; i++)
+  {
+    if (!_filesys_cache[i].owner)
+      return &(_filesys_cache[i]);
+    if (!oldest || (_filesys_cache[i].last_used < oldest->last_used))
+      oldest = &(_filesys_cache[i]);
+  }
+  oldest->owner->sync();
+  return oldest;
+}
+
+static File _filesys_cache_open(File f, const char *mode)
+{
+  if (!f || !_filesys_cache_room)
+    return f;
+  return File(std::make_shared<filesysCacheFile>(f, mode));
+}
 
 // we quietly fix filenames to comply the SPIFFS requirements
 char *_filesys_fix_name(const char *name)
@@ -83,84 +457,371 @@ char *_filesys_fix_name(const char *name)
 }
 
 
-static char *formatBytes(size_t bytes)   // convert sizes in bytes to KB and MB
+// binary search of the index; returns the position of the name or where it belongs
+static uint16_t _filesys_index_search(const char *filename, bool *found)
 {
-  static char fmt_buf[MAX_FORMATBYTES + 1];
-  if (bytes < 1024)
-    snprintf(fmt_buf, MAX_FORMATBYTES, "  %4d Bs", bytes);
-  else if (bytes < (1024 * 1024))
-    snprintf(fmt_buf, MAX_FORMATBYTES, "%6.1f KB", (bytes / 1024.0));
-  else if (bytes < (1024 * 1024 * 1024))
-    snprintf(fmt_buf, MAX_FORMATBYTES, "%6.1f MB", (bytes / 1024.0 / 1024.0));
-  else
-    snprintf(fmt_buf, MAX_FORMATBYTES, "%6.1f GB", (bytes / 1024.0 / 1024.0 / 1024.0));
+  uint16_t lo = 0;
+  uint16_t hi = _filesys_index_count;
+  *found = false;
+  while (lo < hi)
+  {
+    uint16_t mid = (lo + hi) / 2;
+    int order = strcmp(_filesys_index[mid].name, filename);
+    if (!order)
+    {
+      *found = true;
+      return mid;
+    }
+    if (order < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static void _filesys_index_drop()
+{
+  // the index could not be kept up to date; lookups go to the storage from now on
+  free(_filesys_index);
+  _filesys_index = NULL;
+  _filesys_index_count = 0;
+  _filesys_index_room = 0;
+  _filesys_index_ready = false;
+}
+
+static void _filesys_index_update(const char *filename, uint32_t size)
+{
+  if (!_filesys_index_ready)
+    return;
+
+  bool found;
+  uint16_t pos = _filesys_index_search(filename, &found);
+  if (!found)
+  {
+    if (_filesys_index_count == _filesys_index_room)
+    {
+      uint16_t room = _filesys_index_room ? (_filesys_index_room * 2) : 32;
+      filesysEntry_t *index = (filesysEntry_t *)realloc(_filesys_index, room * sizeof(filesysEntry_t));
+      if (!index)
+      {
+        _filesys_index_drop();
+        return;
+      }
+      _filesys_index = index;
+      _filesys_index_room = room;
+    }
+    memmove(&(_filesys_index[pos + 1]), &(_filesys_index[pos]), (_filesys_index_count - pos) * sizeof(filesysEntry_t));
+    _filesys_index_count++;
+    snprintf(_filesys_index[pos].name, MAX_FILENAME_LEN + 1, "%s", filename);
+    _filesys_index[pos].type = filesysGetType(filename);
+  }
+  _filesys_index[pos].size = size;
+}
+
+static void _filesys_index_remove(const char *filename)
+{
+  if (!_filesys_index_ready)
+    return;
+
+  bool found;
+  uint16_t pos = _filesys_index_search(filename, &found);
+  if (!found)
+    return;
+  _filesys_index_count--;
+  memmove(&(_filesys_index[pos]), &(_filesys_index[pos + 1]), (_filesys_index_count - pos) * sizeof(filesysEntry_t));
+}
+
+static void _filesys_index_build()
+{
+  // the only full scan of the flash
+  _filesys_index_drop();
+  _filesys_index_ready = true;
+  File root = g_storage->open("/", "r");
+  File file;
+  while (root && (file = root.openNextFile()) && _filesys_index_ready)
+  {
+    if (!file.isDirectory())
+      _filesys_index_update(file.path(), file.size());
+    file.close();
+  }
+  root.close();
+}
+
+static bool _filesys_exists(const char *filename)
+{
+  if (!_filesys_index_ready)
+    return g_storage->exists(filename);
+  bool found;
+  _filesys_index_search(filename, &found);
+  return found;
+}
+
+static void _filesys_remove(const char *filename)
+{
+  if (_filesys_exists(filename))
+    g_storage->remove(filename);
+  _filesys_index_remove(filename);
+}
+
+// the hidden file with the digest of a file; NULL when the name is too long to have one
+static char *_filesys_digest_name(const char *name)
+{
+  static char sidecar[MAX_FILENAME_LEN + 1];
 
-  fmt_buf[MAX_FORMATBYTES] = 0;
-  return fmt_buf;
+  char *filename = _filesys_fix_name(name);
+  if (snprintf(sidecar, MAX_FILENAME_LEN, "/.%s.sum", filename + 1) >= MAX_FILENAME_LEN)
+    return NULL;
+  return sidecar;
+}
+
+// add the bytes from the current position of the file up to 'end' to the digest
+static void _filesys_digest_range(File *file, digest_t *digest, uint32_t end)
+{
+  uint8_t block[512];
+  while (file->position() < end)
+  {
+    size_t len = end - file->position();
+    if (len > sizeof(block))
+      len = sizeof(block);
+    len = file->read(block, len);
+    if (!len)
+      break;
+    digestUpdate(digest, block, len);
+  }
+}
+
+static int _filesys_format_bytes(size_t bytes, char *buf, size_t size)   // convert sizes in bytes to KB and MB
+{
+  if (bytes < 1024)
+    return snprintf(buf, size, "  %4u Bs", (unsigned int)bytes);
+  if (bytes < (1024 * 1024))
+    return snprintf(buf, size, "%6.1f KB", (bytes / 1024.0));
+  if (bytes < (1024 * 1024 * 1024))
+    return snprintf(buf, size, "%6.1f MB", (bytes / 1024.0 / 1024.0));
+  return snprintf(buf, size, "%6.1f GB", (bytes / 1024.0 / 1024.0 / 1024.0));
 }
 
-bool filesysInit()   // Start the SPIFFS and list all contents
+bool filesysInit()   // Start the storage (see storage.h) and list all contents
 {
   bool success = false;
-  // attempt to start
-  success = SPIFFS.begin();
-  if (!success)
-    success = SPIFFS.begin(true); // attempt to format SPIFFS
+  // attempt to start; the SPIFFS backend formats the flash when it can not be mounted
+  success = g_storage->begin();
 
-  if (success)   // Start the SPI Flash File System (SPIFFS)
+  if (success)
   {
-    _spiffs_dir = SPIFFS.open("/", "r");
+    _filesys_index_build();
 
-    DEBUGSERIAL.println("SPIFFS started. Contents:");
-    char *info = filesysGetFileInfo(true, true);
-    while (info)
+    DEBUGSERIAL.printf("%s started. Contents:\n", g_storage->name);
+    filesysDir_t dir;
+    filesysEntry_t entry;
+    char line[MAX_FILENAME_LEN + MAX_FORMATBYTES + 4];
+    filesysDirBegin(&dir, NULL, true);
+    while (filesysDirNext(&dir, &entry))
     {
-      DEBUGSERIAL.printf("\t%s\n", info);
-      info = filesysGetFileInfo(false, true);
+      filesysFormatEntry(&entry, line, sizeof(line));
+      DEBUGSERIAL.printf("\t%s\n", line);
     }
+    filesysDirEnd(&dir);
     DEBUGSERIAL.printf("\n");
     return true;
   }
-  DEBUGSERIAL.println("SPIFFS failed.");
+  DEBUGSERIAL.printf("%s failed.\n", g_storage->name);
   return false;
 }
 
 void filesysLoop()
 {
-  // currently nothing to do
+  //-- the cache gives way when memory runs low
+  if (_filesys_cache_count && (ESP.getFreeHeap() < FILESYS_CACHE_LOW_HEAP))
+    _filesys_cache_release();
+}
+
+void filesysSync()
+{
+  // write all cached data to the storage
+  for (uint16_t i = 0; i < _filesys_cache_count; i++)
+    if (_filesys_cache[i].owner)
+      _filesys_cache[i].owner->sync();
+}
+
+bool filesysCacheSetup(uint16_t pages, bool psram)
+{
+  // the cached data is written first; the new cache is allocated when it is first used
+  _filesys_cache_release();
+  _filesys_cache_room = pages;
+  _filesys_cache_psram = psram;
+  return !pages || _filesys_cache_alloc();
+}
+
+int filesysCacheStats(char *text, size_t size)
+{
+  filesysCacheStats_t *stats = &_filesys_cache_stats;
+  uint32_t saved = (stats->writes > stats->flash_writes) ? (stats->writes - stats->flash_writes) : 0;
+  return snprintf(text, size, "%u pages of %u bytes, %u writes, %u merged (%u%%), %u flash writes, %u saved",
+                  _filesys_cache_count, FILESYS_CACHE_PAGE_SIZE, stats->writes, stats->merged,
+                  stats->writes ? ((stats->merged * 100) / stats->writes) : 0, stats->flash_writes, saved);
+}
+
+#ifdef FILESYS_UPLOAD_PIPELINE
+// the pipeline writer task stores the blocks; the digest is computed on the same task
+static bool _filesys_upload_sink(void *ctx, const uint8_t *buf, size_t len)
+{
+  digestUpdate(&_filesys_upload_digest, buf, len);
+  return (((File *)ctx)->write(buf, len) == len);
 }
+#endif
 
 bool filesysSaveStart(const char *name)
 {
+  return filesysSaveStartAt(name, 0);
+}
+
+bool filesysSaveStartAt(const char *name, uint32_t offset)
+{
+  //-- there is one upload at a time
+  if (_filesys_upload_file)
+    return false;
+
+  //-- the old digest is gone as soon as the file changes
+  char *sidecar = _filesys_digest_name(name);
+  if (sidecar)
+    _filesys_remove(sidecar);
 
   char *filename = _filesys_fix_name(name);
+  strcpy(_filesys_upload_name, filename);
   _filesys_upload_size = 0;
-  DEBUGSERIAL.printf("handleFileUpload Name: %s\n", filename);
-  _filesys_upload_file = SPIFFS.open(filename, "w"); // Open the file for writing in SPIFFS (create if it doesn't exist)
+  digestBegin(&_filesys_upload_digest);
+  DEBUG("handleFileUpload Name: %s @%u\n", filename, offset);
+  if (!offset)
+  {
+    _filesys_upload_file = g_storage->open(filename, "w"); // Open the file for writing in SPIFFS (create if it doesn't exist)
+  }
+  else
+  {
+    //-- resume: the stream overwrites the file from the offset; the offset can not be beyond the end
+    //-- the digest starts with the content before the offset
+    _filesys_upload_file = g_storage->open(filename, "r+");
+    if (_filesys_upload_file && (offset <= _filesys_upload_file.size()) && _filesys_upload_file.seek(0))
+      _filesys_digest_range(&_filesys_upload_file, &_filesys_upload_digest, offset);
+    if (_filesys_upload_file && ((_filesys_upload_file.position() != offset) || !_filesys_upload_file.seek(offset)))
+    {
+      _filesys_upload_file.close();
+      _filesys_upload_file = File();
+    }
+  }
 
-  if (_filesys_upload_file)
-    return true;
-  return false;
+  if (!_filesys_upload_file)
+    return false;
+  _filesys_index_update(filename, _filesys_upload_file.size());
+#ifndef FILESYS_UPLOAD_PIPELINE
+  _filesys_upload_file = _filesys_cache_open(_filesys_upload_file, offset ? "r+" : "w");
+#endif
+
+#ifdef FILESYS_UPLOAD_PIPELINE
+  if (!pipelineBegin(&_filesys_upload_pipe, _filesys_upload_sink, &_filesys_upload_file))
+  {
+    _filesys_upload_file.close();
+    _filesys_upload_file = File();
+    return false;
+  }
+#else
+  _filesys_upload_fill = 0;
+#endif
+  return true;
+}
+
+size_t filesysSaveWritable()
+{
+  // the number of bytes filesysSaveWrite() accepts without waiting for the flash
+  if (!_filesys_upload_file)
+    return 0;
+#ifdef FILESYS_UPLOAD_PIPELINE
+  return pipelineWritable(&_filesys_upload_pipe);
+#else
+  return FILESYS_BLOCK_SIZE;
+#endif
 }
 
 bool filesysSaveWrite(uint8_t *buf, size_t size)
 {
-  if (_filesys_upload_file)
+  if (!_filesys_upload_file)
+    return false;
+
+  _filesys_upload_size += size;
+
+#ifdef FILESYS_UPLOAD_PIPELINE
+  return pipelineWrite(&_filesys_upload_pipe, buf, size);
+#else
+  digestUpdate(&_filesys_upload_digest, buf, size);
+
+  /*
+    the data is written to flash in whole blocks regardless of how the caller chunks it.
+    a partial block is topped up first, whole blocks go straight from the caller's buffer
+    and the remainder is kept for the next call.
+  */
+  if (_filesys_upload_fill)
   {
-    _filesys_upload_file.write(buf, size); // Write the received bytes to the file
-    _filesys_upload_size += size;
+    size_t len = FILESYS_BLOCK_SIZE - _filesys_upload_fill;
+    if (len > size)
+      len = size;
+    memcpy(_filesys_upload_block + _filesys_upload_fill, buf, len);
+    _filesys_upload_fill += len;
+    buf += len;
+    size -= len;
+    if (_filesys_upload_fill < FILESYS_BLOCK_SIZE)
+      return true;
+    _filesys_upload_fill = 0;
+    if (_filesys_upload_file.write(_filesys_upload_block, FILESYS_BLOCK_SIZE) != FILESYS_BLOCK_SIZE)
+      return false;
   }
-  return true; // TODO check return code and/or byte count and return appropriate status
+
+  size_t len = size - (size % FILESYS_BLOCK_SIZE);
+  if (len && (_filesys_upload_file.write(buf, len) != len))
+    return false;
+
+  memcpy(_filesys_upload_block, buf + len, size - len);
+  _filesys_upload_fill = size - len;
+  return true;
+#endif
 }
 
 bool filesysSaveFinish()
 {
   if (_filesys_upload_file)
   {
+#ifdef FILESYS_UPLOAD_PIPELINE
+    bool success = pipelineFinish(&_filesys_upload_pipe);
+#else
+    bool success = true;
+    if (_filesys_upload_fill && (_filesys_upload_file.write(_filesys_upload_block, _filesys_upload_fill) != _filesys_upload_fill))
+      success = false;
+    _filesys_upload_fill = 0;
+#endif
+    //-- a resumed upload may end before the old end of the file; the digest includes the rest
+    uint32_t end = _filesys_upload_file.size();
+    if (success && (_filesys_upload_file.position() < end) && _filesys_upload_file.seek(_filesys_upload_file.position()))
+      _filesys_digest_range(&_filesys_upload_file, &_filesys_upload_digest, end);
     _filesys_upload_file.close(); // Close the file again
-    DEBUGSERIAL.printf("Upload %d bytes\n", _filesys_upload_size);
+    _filesys_upload_file = File();
+    _filesys_index_update(_filesys_upload_name, end);
+
+    char *sidecar = _filesys_digest_name(_filesys_upload_name);
+    if (success && sidecar)
+    {
+      char text[DIGEST_TEXT_LEN];
+      digestFinish(&_filesys_upload_digest, text, sizeof(text));
+      File f = _filesys_cache_open(g_storage->open(sidecar, "w"), "w");
+      if (f)
+      {
+        f.printf("%s\n", text);
+        _filesys_index_update(sidecar, f.size());
+        f.close();
+      }
+    }
+    DEBUG("Upload %d bytes\n", _filesys_upload_size);
     _filesys_upload_size = 0;
-    return true;
+    return success;
   }
   return false;
 }
@@ -168,13 +829,71 @@ bool filesysSaveFinish()
 bool filesysExists(const char *name)
 {
   char *filename = _filesys_fix_name(name);
-  return SPIFFS.exists(filename);
+  return _filesys_exists(filename);
 }
 
 void filesysDelete(const char *name)
 {
   char *filename = _filesys_fix_name(name);
-  SPIFFS.remove(filename);
+  _filesys_remove(filename);
+  char *sidecar = _filesys_digest_name(name);
+  if (sidecar)
+    _filesys_remove(sidecar);
+}
+
+bool filesysGetDigest(const char *name, char *text, size_t size)
+{
+  // the digest stored when the file was uploaded
+  char *sidecar = _filesys_digest_name(name);
+  if (!sidecar || !_filesys_exists(sidecar))
+    return false;
+  File f = g_storage->open(sidecar, "r");
+  if (!f)
+    return false;
+  size_t len = streamReadLine(&f, text, size, false);
+  f.close();
+  FILESYS_STRIP_NL(text, len);
+  return (len > 0);
+}
+
+bool filesysCanDigest(const char *name)
+{
+  // false when the name is too long for a sidecar, so the file is stored without a digest
+  return _filesys_digest_name(name) != NULL;
+}
+
+bool filesysComputeDigest(const char *name, char *text, size_t size)
+{
+  // the digest of the current content of the file
+  File f = g_storage->open(_filesys_fix_name(name), "r");
+  if (!f)
+    return false;
+  digest_t digest;
+  digestBegin(&digest);
+  _filesys_digest_range(&f, &digest, f.size());
+  f.close();
+  digestFinish(&digest, text, size);
+  return true;
+}
+
+int32_t filesysGetSize(const char *name)
+{
+  // the size in bytes; -1 when the file does not exist
+  char *filename = _filesys_fix_name(name);
+  if (_filesys_index_ready)
+  {
+    bool found;
+    uint16_t pos = _filesys_index_search(filename, &found);
+    return found ? _filesys_index[pos].size : -1;
+  }
+  if (!g_storage->exists(filename))
+    return -1;
+  File f = g_storage->open(filename, "r");
+  if (!f)
+    return -1;
+  int32_t size = f.size();
+  f.close();
+  return size;
 }
 
 File filesysOpen(const char *name, const char *mode)
@@ -182,64 +901,176 @@ File filesysOpen(const char *name, const char *mode)
   if (mode == NULL)
     mode = "r";
   char *filename = _filesys_fix_name(name);
-  File f = SPIFFS.open(filename, mode); // Open the file
+  File f = g_storage->open(filename, mode); // Open the file
   if (!f)
   {
     MESSAGE("Failed to open %s for mode[%s]\n", name, mode);
   }
+  else if ((mode[0] != 'r') || (mode[1] == '+'))
+  {
+    _filesys_index_update(filename, f.size()); // the file may be new; filesysClose() has the final size
+    f = _filesys_cache_open(f, mode);
+  }
   return f;
-  //return SPIFFS.open(name, FILE_READ); // Open the file
+  //return g_storage->open(name, FILE_READ); // Open the file
 }
 
 
 void filesysClose(File f)
 {
+  //-- the file may have been written
+  if (f && !f.isDirectory())
+    _filesys_index_update(f.path(), f.size());
   f.close();
   VERBOSE("\n");
 }
 
-char *filesysGetFileInfo(bool first, bool show_hidden)
+bool filesysGlobMatch(const char *pattern, const char *name)
 {
-  static char buf[MAX_FILENAME_LEN + MAX_FORMATBYTES + 1];
-  File file;
-
-  bool found;
-  do
+  // '*' matches any run of characters and '?' a single character; the case is ignored
+  // after a mismatch the last '*' takes one more character, so this never backtracks further
+  const char *star = NULL;
+  const char *resume = NULL;
+  while (*name)
   {
-    buf[0] = 0;
-    found = false;
-    if (first)
+    if (*pattern == '*')
+    {
+      star = pattern++;
+      resume = name;
+    }
+    else if ((*pattern == '?') || (*pattern && (tolower(*pattern) == tolower(*name))))
+    {
+      pattern++;
+      name++;
+    }
+    else if (star)
     {
-      _spiffs_dir.rewindDirectory();
-      first = false;
+      pattern = star + 1;
+      name = ++resume;
     }
+    else
+      return false;
+  }
+  while (*pattern == '*')
+    pattern++;
+  return !*pattern;
+}
 
-    file = _spiffs_dir.openNextFile();
+void filesysDirBegin(filesysDir_t *dir, const char *pattern, bool show_hidden)
+{
+  snprintf(dir->pattern, sizeof(dir->pattern), "%s", pattern ? pattern : "");
+  dir->show_hidden = show_hidden;
+  dir->last[0] = 0;
+  dir->done = false;
+  dir->storage_dir = File();
+  if (!_filesys_index_ready)
+    dir->storage_dir = g_storage->open("/", "r");
+}
 
-    if (file)
+static bool _filesys_dir_match(filesysDir_t *dir, const char *name)
+{
+  // the name is without the leading '/'
+  if (!dir->pattern[0])
+    return (name[0] != '.') || dir->show_hidden;
+  if ((name[0] == '.') && (dir->pattern[0] != '.'))
+    return false;
+  return filesysGlobMatch(dir->pattern, name);
+}
+
+bool filesysDirNext(filesysDir_t *dir, filesysEntry_t *entry)
+{
+  if (dir->done)
+    return false;
+  if (_filesys_index_ready)
+  {
+    //-- continue after the last name; the index may have changed since
+    bool found = false;
+    uint16_t pos = dir->last[0] ? _filesys_index_search(dir->last, &found) : 0;
+    if (found)
+      pos++;
+    for (; pos < _filesys_index_count; pos++)
     {
-      const char *name = file.name();
-      if (name[0] == '/')
-        name++;
-      // skip hidden files unless told to include them
-      if ((name[0] == '.') && !show_hidden)
-        continue;
-
-      if (file.isDirectory())
+      if (_filesys_dir_match(dir, _filesys_index[pos].name + 1))
       {
-        snprintf(buf, (MAX_FILENAME_LEN + MAX_FORMATBYTES), "[%s]", name);
+        *entry = _filesys_index[pos];
+        strcpy(dir->last, entry->name);
+        return true;
       }
-      else
-        snprintf(buf, (MAX_FILENAME_LEN + MAX_FORMATBYTES), "%s\t%s", name, formatBytes(file.size()));
-      found = true;
     }
-    else
-      break;
-  } while (!found);
+    dir->done = true;
+    return false;
+  }
+
+  File file;
+  while (dir->storage_dir && (file = dir->storage_dir.openNextFile()))
+  {
+    const char *name = file.path();
+    if (!file.isDirectory() && _filesys_dir_match(dir, name + 1))
+    {
+      snprintf(entry->name, sizeof(entry->name), "%s", name);
+      entry->size = file.size();
+      entry->type = filesysGetType(name);
+      file.close();
+      strcpy(dir->last, entry->name);
+      return true;
+    }
+    file.close();
+  }
+  dir->done = true;
+  return false;
+}
+
+void filesysDirEnd(filesysDir_t *dir)
+{
+  if (dir->storage_dir)
+    dir->storage_dir.close();
+  dir->storage_dir = File();
+}
+
+int filesysFormatEntry(const filesysEntry_t *entry, char *buf, size_t size)
+{
+  // the listing line: the name without the leading '/', a tab and the size
+  int len = snprintf(buf, size, "%s\t", entry->name + 1);
+  if ((len > 0) && ((size_t)len < size))
+    len += _filesys_format_bytes(entry->size, buf + len, size - len);
+  return ((len < 0) || ((size_t)len < size)) ? len : (size - 1);
+}
+
+char *filesysGetFileInfo(bool first, bool show_hidden)
+{
+  // the older single cursor interface; it is not reentrant
+  static char buf[MAX_FILENAME_LEN + MAX_FORMATBYTES + 4];
+  static filesysDir_t dir;
+  filesysEntry_t entry;
 
-  if (buf[0])
-    return buf;
-  return 0;
+  if (first)
+  {
+    filesysDirEnd(&dir);
+    filesysDirBegin(&dir, NULL, show_hidden);
+  }
+  if (!filesysDirNext(&dir, &entry))
+  {
+    filesysDirEnd(&dir);
+    return 0;
+  }
+  filesysFormatEntry(&entry, buf, sizeof(buf));
+  return buf;
+}
+
+uint8_t filesysReadHex(Stream *handle, hexDecoder_t *hex)
+{
+  // the decoder has been started with hexBegin(); the sink gets the data as contiguous blocks
+  uint8_t chunk[512];
+  int available;
+
+  while (!hex->eof && ((available = handle->available()) > 0))
+  {
+    size_t count = ((size_t)available < sizeof(chunk)) ? available : sizeof(chunk);
+    count = handle->readBytes(chunk, count);
+    if (!count || !hexDecode(hex, chunk, count))
+      break;
+  }
+  return hexFinish(hex);
 }
 
 uint8_t filesysGetType(const char *name)
@@ -303,4 +1134,56 @@ uint16_t streamReadLine(Stream *handle, char *buf, uint16_t size, bool escaped_c
   return len;
 }
 
+uint16_t streamReadLine(File *handle, char *buf, uint16_t size, bool escaped_characters)
+{
+  /*
+    a file is read in bulk: we take as much as fits in the buffer, use it up to
+    the end of the line and seek back to the first byte we did not use.
+    the line is filtered in place, the same way as the Stream version does.
+  */
+  size--; // save space for a null terminator
+  uint16_t len = 0;
+  bool special_char = false;
+
+  size_t start = handle->position();
+  size_t count = handle->read((uint8_t *)buf, size);
+  size_t used = 0;
+
+  while (used < count)
+  {
+    char c = buf[used++];
+
+    if (escaped_characters)
+    {
+      if (special_char)
+      {
+        if (c == 'n')
+          c = '\n';
+        special_char = false;
+      }
+      else
+      {
+        if (c == '\\')
+        {
+          special_char = true;
+          continue;
+        }
+      }
+    }
+
+    if ((c == '\r'))
+      continue;
+
+    buf[len++] = c;
+    if (c == '\n')
+      break;
+  }
+
+  if (used < count)
+    handle->seek(start + used);
+
+  buf[len] = 0;
+  return len;
+}
+
 #endif
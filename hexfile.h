@@ -0,0 +1,301 @@
+#ifndef __HEXFILE_H
+#define __HEXFILE_H
+
+/* ***************************************************************************
+* File:    hexfile
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### HEXFILE API
+
+A streaming Intel HEX decoder. The input may be handed over in pieces of any size;
+a record which is split across pieces is continued with the next piece.
+
+The data of consecutive records is coalesced and handed to a sink as contiguous blocks
+of up to HEX_BLOCK_SIZE bytes. A new block starts when the address is not contiguous.
+
+Supported records: 00 data, 01 end of file, 02 extended segment address,
+03 start segment address, 04 extended linear address and 05 start linear address.
+Every record checksum is checked. Anything after the end of file record is ignored.
+--- */
+
+#define HEX_BLOCK_SIZE  1024
+#define HEX_RECORD_SIZE (5 + 255) // count, address, type, data and checksum
+
+#define HEX_OK           0
+#define HEX_ERR_FORMAT   1 // not a valid record
+#define HEX_ERR_CHECKSUM 2
+#define HEX_ERR_RECORD   3 // unknown record type or a bad address record
+#define HEX_ERR_SINK     4 // the sink refused a block
+#define HEX_ERR_NO_EOF   5 // the end of file record is missing
+
+#define HEX_NIBBLE_BAD   0xFF
+
+typedef bool (*hexSink_t)(void *ctx, uint32_t address, const uint8_t *data, size_t len);
+
+typedef struct hexDecoder_s
+{
+  hexSink_t sink;
+  void *ctx;
+  uint8_t error;              // HEX_xxx
+  bool eof;                   // the end of file record has been seen
+  bool in_record;
+  uint8_t high_nibble;        // the first half of a byte; HEX_NIBBLE_BAD when there is none
+  uint16_t record_len;
+  uint8_t record[HEX_RECORD_SIZE];
+  uint32_t base;              // from the extended address records
+  uint32_t start;             // from the start address records
+  uint32_t records;           // records decoded, to report where an error is
+  uint32_t bytes;             // data bytes decoded
+  uint32_t block_address;
+  uint16_t block_fill;
+  uint8_t block[HEX_BLOCK_SIZE];
+} hexDecoder_t;
+
+static uint8_t _hex_nibbles[256];
+static bool _hex_nibbles_ready = false;
+
+static void _hexNibbleTable()
+{
+  memset(_hex_nibbles, HEX_NIBBLE_BAD, sizeof(_hex_nibbles));
+  for (int i = 0; i < 10; i++)
+    _hex_nibbles['0' + i] = i;
+  for (int i = 0; i < 6; i++)
+  {
+    _hex_nibbles['A' + i] = 10 + i;
+    _hex_nibbles['a' + i] = 10 + i;
+  }
+  _hex_nibbles_ready = true;
+}
+
+static void _hexFlush(hexDecoder_t *hex)
+{
+  if (!hex->block_fill)
+    return;
+  if (!(*hex->sink)(hex->ctx, hex->block_address, hex->block, hex->block_fill))
+    hex->error = HEX_ERR_SINK;
+  hex->block_fill = 0;
+}
+
+// append data to the block; a gap in the addresses or a full block sends the block to the sink
+static void _hexEmit(hexDecoder_t *hex, uint32_t address, const uint8_t *data, size_t len)
+{
+  while (len && !hex->error)
+  {
+    if (hex->block_fill && ((address != (hex->block_address + hex->block_fill)) || (hex->block_fill == HEX_BLOCK_SIZE)))
+      _hexFlush(hex);
+    if (!hex->block_fill)
+      hex->block_address = address;
+    size_t count = HEX_BLOCK_SIZE - hex->block_fill;
+    if (count > len)
+      count = len;
+    memcpy(hex->block + hex->block_fill, data, count);
+    hex->block_fill += count;
+    address += count;
+    data += count;
+    len -= count;
+  }
+}
+
+// a complete record has been collected
+static void _hexRecord(hexDecoder_t *hex)
+{
+  uint8_t *record = hex->record;
+  hex->records++;
+
+  if ((hex->high_nibble != HEX_NIBBLE_BAD) || (hex->record_len < 5) || (hex->record_len != (record[0] + 5)))
+  {
+    hex->error = HEX_ERR_FORMAT;
+    return;
+  }
+  uint8_t sum = 0;
+  for (uint16_t i = 0; i < hex->record_len; i++)
+    sum += record[i];
+  if (sum)
+  {
+    hex->error = HEX_ERR_CHECKSUM;
+    return;
+  }
+
+  uint8_t count = record[0];
+  uint16_t offset = (record[1] << 8) | record[2];
+  uint8_t *data = record + 4;
+  switch (record[3])
+  {
+    case 0x00:
+      _hexEmit(hex, hex->base + offset, data, count);
+      hex->bytes += count;
+      break;
+    case 0x01:
+      hex->eof = true;
+      break;
+    case 0x02:
+      if (count != 2)
+      {
+        hex->error = HEX_ERR_RECORD; //-- the data is not there to read
+        break;
+      }
+      hex->base = ((data[0] << 8) | data[1]) << 4;
+      break;
+    case 0x04:
+      if (count != 2)
+      {
+        hex->error = HEX_ERR_RECORD;
+        break;
+      }
+      hex->base = (uint32_t)((data[0] << 8) | data[1]) << 16;
+      break;
+    case 0x03:
+    case 0x05:
+      if (count != 4)
+      {
+        hex->error = HEX_ERR_RECORD;
+        break;
+      }
+      hex->start = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | (data[2] << 8) | data[3];
+      break;
+    default:
+      hex->error = HEX_ERR_RECORD;
+      break;
+  }
+}
+
+/* ---
+#### hexBegin()
+
+- input: hex **hexDecoder_t ptr** the decoder storage; it is owned by the caller
+- input: sink **hexSink_t** receives the contiguous blocks; it returns `false` to stop the decoder
+- input: ctx **void ptr** passed to the sink
+--- */
+void hexBegin(hexDecoder_t *hex, hexSink_t sink, void *ctx)
+{
+  if (!_hex_nibbles_ready)
+    _hexNibbleTable();
+
+  hex->sink = sink;
+  hex->ctx = ctx;
+  hex->error = HEX_OK;
+  hex->eof = false;
+  hex->in_record = false;
+  hex->high_nibble = HEX_NIBBLE_BAD;
+  hex->record_len = 0;
+  hex->base = 0;
+  hex->start = 0;
+  hex->records = 0;
+  hex->bytes = 0;
+  hex->block_fill = 0;
+}
+
+/* ---
+#### hexDecode()
+
+- input: hex **hexDecoder_t ptr** a decoder
+- input: text **uint8_t ptr** the next piece of the HEX text
+- input: len **size_t** the number of characters
+- return: **bool** `false` once the decoder has stopped with an error
+--- */
+bool hexDecode(hexDecoder_t *hex, const uint8_t *text, size_t len)
+{
+  const uint8_t *end = text + len;
+
+  while ((text < end) && !hex->error && !hex->eof)
+  {
+    if (!hex->in_record)
+    {
+      uint8_t c = *text++;
+      if (c == ':')
+      {
+        hex->in_record = true;
+        hex->record_len = 0;
+        hex->high_nibble = HEX_NIBBLE_BAD;
+      }
+      else if ((c != '\r') && (c != '\n') && (c != ' ') && (c != '\t'))
+        hex->error = HEX_ERR_FORMAT;
+      continue;
+    }
+
+    //-- the hot loop: pairs of hex digits up to the end of the line
+    while (text < end)
+    {
+      uint8_t nibble = _hex_nibbles[*text];
+      if (nibble == HEX_NIBBLE_BAD)
+        break;
+      text++;
+      if (hex->high_nibble == HEX_NIBBLE_BAD)
+      {
+        hex->high_nibble = nibble;
+        continue;
+      }
+      if (hex->record_len == HEX_RECORD_SIZE)
+      {
+        hex->error = HEX_ERR_FORMAT;
+        break;
+      }
+      hex->record[hex->record_len++] = (hex->high_nibble << 4) | nibble;
+      hex->high_nibble = HEX_NIBBLE_BAD;
+    }
+    if ((text == end) || hex->error)
+      break;
+
+    uint8_t c = *text++;
+    if ((c != '\r') && (c != '\n'))
+    {
+      hex->error = HEX_ERR_FORMAT;
+      break;
+    }
+    hex->in_record = false;
+    _hexRecord(hex);
+  }
+  return !hex->error;
+}
+
+/* ---
+#### hexFinish()
+
+Decode a last record which has no line end and hand the last block to the sink.
+
+- input: hex **hexDecoder_t ptr** a decoder
+- return: **uint8_t** HEX_OK or the HEX_ERR_xxx which stopped the decoder
+--- */
+uint8_t hexFinish(hexDecoder_t *hex)
+{
+  if (!hex->error && !hex->eof && hex->in_record)
+  {
+    hex->in_record = false;
+    _hexRecord(hex);
+  }
+  if (!hex->error)
+    _hexFlush(hex);
+  if (!hex->error && !hex->eof)
+    hex->error = HEX_ERR_NO_EOF;
+  return hex->error;
+}
+
+/* ---
+#### hexErrorText()
+
+- input: error **uint8_t** a HEX_xxx code
+- return: **char ptr** a short description
+--- */
+const char *hexErrorText(uint8_t error)
+{
+  switch (error)
+  {
+    case HEX_OK:           return "OK";
+    case HEX_ERR_FORMAT:   return "invalid record";
+    case HEX_ERR_CHECKSUM: return "checksum mismatch";
+    case HEX_ERR_RECORD:   return "unsupported record";
+    case HEX_ERR_SINK:     return "data rejected";
+    case HEX_ERR_NO_EOF:   return "missing end of file record";
+  }
+  return "unknown error";
+}
+
+#endif
+
+/*eof*/
@@ -0,0 +1,469 @@
+/* ***************************************************************************
+* File:    host/arduino_host.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### HOST ARDUINO
+
+The host implementation of the Arduino API in host/include: time, Print/Stream, Serial on
+stdin/stdout, fs::File forwarding to its FileImpl, and WiFiClient/WiFiServer on loopback sockets.
+It is built into the arduino_host library which the host binary, the tests and the benchmarks link.
+--- */
+
+#include "Arduino.h"
+#include "FS.h"
+#include "FSImpl.h"
+#include "SPIFFS.h"
+#include "WiFi.h"
+#include "ESPmDNS.h"
+
+#include <chrono>
+#include <thread>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+
+// -------- time ------------------------------------------------------------------------------
+
+static const std::chrono::steady_clock::time_point _host_start = std::chrono::steady_clock::now();
+
+unsigned long millis()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _host_start).count();
+}
+
+unsigned long micros()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _host_start).count();
+}
+
+void delay(unsigned long ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield()
+{
+  std::this_thread::yield();
+}
+
+// there is no PSRAM on a host; the callers fall back to malloc()
+void *ps_malloc(size_t size)
+{
+  return NULL;
+}
+
+EspClass ESP;
+
+
+// -------- Print and Stream ------------------------------------------------------------------
+
+size_t Print::printf(const char *format, ...)
+{
+  char buf[256];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (len < 0)
+    return 0;
+  if ((size_t)len < sizeof(buf))
+    return write((const uint8_t *)buf, len);
+
+  //-- like the core, a long text is formatted into a temporary buffer
+  char *text = (char *)malloc(len + 1);
+  if (!text)
+    return 0;
+  va_start(args, format);
+  vsnprintf(text, len + 1, format, args);
+  va_end(args);
+  size_t count = write((const uint8_t *)text, len);
+  free(text);
+  return count;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+  size_t count = 0;
+  while (count < length)
+  {
+    int c = read();
+    if (c < 0)
+      break;
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length)
+{
+  size_t count = 0;
+  while (count < length)
+  {
+    int c = read();
+    if ((c < 0) || (c == terminator))
+      break;
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+
+// -------- Serial ----------------------------------------------------------------------------
+
+HardwareSerial Serial(STDIN_FILENO);
+HardwareSerial Serial1(-1);
+
+int HardwareSerial::available()
+{
+  if (fd < 0)
+    return 0;
+  int count = 0;
+  if (ioctl(fd, FIONREAD, &count))
+    count = 0;
+  return count + ((peeked >= 0) ? 1 : 0);
+}
+
+int HardwareSerial::read()
+{
+  if (peeked >= 0)
+  {
+    int c = peeked;
+    peeked = -1;
+    return c;
+  }
+  uint8_t c;
+  if ((fd < 0) || !available() || (::read(fd, &c, 1) != 1))
+    return -1;
+  return c;
+}
+
+int HardwareSerial::peek()
+{
+  if (peeked < 0)
+    peeked = read();
+  return peeked;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+  if (fd < 0)
+    return size; // nothing is attached to the UART
+  size = fwrite(buffer, 1, size, stdout);
+  fflush(stdout);
+  return size;
+}
+
+
+// -------- files -----------------------------------------------------------------------------
+
+namespace fs
+{
+
+size_t File::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t File::write(const uint8_t *buf, size_t size)
+{
+  return *this ? _p->write(buf, size) : 0;
+}
+
+int File::available()
+{
+  return *this ? (int)(_p->size() - _p->position()) : 0;
+}
+
+int File::read()
+{
+  uint8_t c;
+  if (!*this || (_p->read(&c, 1) != 1))
+    return -1;
+  return c;
+}
+
+size_t File::read(uint8_t *buf, size_t size)
+{
+  return *this ? _p->read(buf, size) : 0;
+}
+
+int File::peek()
+{
+  if (!*this)
+    return -1;
+  size_t pos = _p->position();
+  int c = read();
+  _p->seek(pos, SeekSet);
+  return c;
+}
+
+void File::flush()
+{
+  if (*this)
+    _p->flush();
+}
+
+bool File::seek(uint32_t pos, SeekMode mode)
+{
+  return *this ? _p->seek(pos, mode) : false;
+}
+
+size_t File::position() const
+{
+  return *this ? _p->position() : 0;
+}
+
+size_t File::size() const
+{
+  return *this ? _p->size() : 0;
+}
+
+bool File::setBufferSize(size_t size)
+{
+  return *this ? _p->setBufferSize(size) : false;
+}
+
+void File::close()
+{
+  if (_p)
+    _p->close();
+  _p = nullptr;
+}
+
+File::operator bool() const
+{
+  return (_p != nullptr) && *_p;
+}
+
+time_t File::getLastWrite()
+{
+  return *this ? _p->getLastWrite() : 0;
+}
+
+const char *File::path() const
+{
+  return *this ? _p->path() : NULL;
+}
+
+const char *File::name() const
+{
+  return *this ? _p->name() : NULL;
+}
+
+boolean File::isDirectory(void)
+{
+  return *this ? _p->isDirectory() : false;
+}
+
+File File::openNextFile(const char *mode)
+{
+  return *this ? File(_p->openNextFile(mode)) : File();
+}
+
+void File::rewindDirectory(void)
+{
+  if (*this)
+    _p->rewindDirectory();
+}
+
+File FS::open(const char *path, const char *mode, const bool create)
+{
+  return _impl ? File(_impl->open(path, mode, create)) : File();
+}
+
+bool FS::exists(const char *path)
+{
+  return _impl && _impl->exists(path);
+}
+
+bool FS::remove(const char *path)
+{
+  return _impl && _impl->remove(path);
+}
+
+bool FS::rename(const char *from, const char *to)
+{
+  return _impl && _impl->rename(from, to);
+}
+
+bool FS::mkdir(const char *path)
+{
+  return _impl && _impl->mkdir(path);
+}
+
+bool FS::rmdir(const char *path)
+{
+  return _impl && _impl->rmdir(path);
+}
+
+} // namespace fs
+
+fs::SPIFFSFS SPIFFS;
+
+
+// -------- network ---------------------------------------------------------------------------
+
+WiFiClass WiFi;
+MDNSResponder MDNS;
+
+static uint16_t _host_port(uint16_t port)
+{
+  const char *offset = getenv("HOST_PORT_OFFSET");
+  return port + (offset ? atoi(offset) : 0);
+}
+
+int hostGetSockName(int fd, struct sockaddr *addr, socklen_t *len)
+{
+  int result = getsockname(fd, addr, len);
+  if (!result && (addr->sa_family == AF_INET))
+  {
+    struct sockaddr_in *in = (struct sockaddr_in *)addr;
+    in->sin_port = htons(ntohs(in->sin_port) - _host_port(0));
+  }
+  return result;
+}
+
+hostSocket_s::~hostSocket_s()
+{
+  if (fd >= 0)
+    ::close(fd);
+}
+
+WiFiClient::WiFiClient(int fd)
+{
+  if (fd >= 0)
+    sock = std::make_shared<hostSocket_s>(fd);
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t size)
+{
+  //-- like the lwIP socket of the ESP32 core, a write blocks until everything is sent or the peer is gone
+  size_t done = 0;
+  while (sock && (done < size))
+  {
+    ssize_t count = send(sock->fd, buf + done, size - done, MSG_NOSIGNAL);
+    if ((count < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+    {
+      usleep(100);
+      continue;
+    }
+    if (count <= 0)
+      break;
+    done += count;
+  }
+  return done;
+}
+
+int WiFiClient::available()
+{
+  if (!sock)
+    return 0;
+  int count = 0;
+  if (ioctl(sock->fd, FIONREAD, &count))
+    count = 0;
+  return count + ((sock->peeked >= 0) ? 1 : 0);
+}
+
+int WiFiClient::read()
+{
+  uint8_t c;
+  return (read(&c, 1) == 1) ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buf, size_t size)
+{
+  if (!sock || !size)
+    return 0;
+  size_t done = 0;
+  if (sock->peeked >= 0)
+  {
+    buf[done++] = (uint8_t)sock->peeked;
+    sock->peeked = -1;
+  }
+  ssize_t count = recv(sock->fd, buf + done, size - done, MSG_DONTWAIT);
+  return done + ((count > 0) ? count : 0);
+}
+
+int WiFiClient::peek()
+{
+  if (sock && (sock->peeked < 0))
+    sock->peeked = read();
+  return sock ? sock->peeked : -1;
+}
+
+uint8_t WiFiClient::connected()
+{
+  if (!sock)
+    return 0;
+  if (available())
+    return 1;
+  char c;
+  ssize_t count = recv(sock->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  return (count > 0) || ((count < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)));
+}
+
+int WiFiClient::setNoDelay(bool nodelay)
+{
+  int value = nodelay;
+  return sock ? setsockopt(sock->fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value)) : -1;
+}
+
+void WiFiServer::begin(uint16_t port)
+{
+  if (port)
+    this->port = port;
+  listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  int value = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(value));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(_host_port(this->port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(listen_fd, max_clients))
+  {
+    fprintf(stderr, "host: can not listen on port %u: %s\n", _host_port(this->port), strerror(errno));
+    ::close(listen_fd);
+    listen_fd = -1;
+    return;
+  }
+  fcntl(listen_fd, F_SETFL, O_NONBLOCK);
+}
+
+bool WiFiServer::hasClient()
+{
+  if ((pending_fd < 0) && (listen_fd >= 0))
+    pending_fd = ::accept(listen_fd, NULL, NULL);
+  return pending_fd >= 0;
+}
+
+WiFiClient WiFiServer::available()
+{
+  hasClient();
+  WiFiClient client(pending_fd);
+  pending_fd = -1;
+  client.setNoDelay(true);
+  return client;
+}
+
+void WiFiServer::end()
+{
+  if (listen_fd >= 0)
+    ::close(listen_fd);
+  listen_fd = -1;
+}
+
+/*eof*/
@@ -0,0 +1,145 @@
+#ifndef __HOST_ARDUINO_H
+#define __HOST_ARDUINO_H
+
+/* ***************************************************************************
+* File:    host/include/Arduino.h
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### HOST ARDUINO API
+
+The part of the ESP32 Arduino core 2.0.x API which the sketch uses, so the parser,
+filesys, storage and pipeline can be built and exercised on a host (see host/arduino_host.cpp).
+The declarations follow the core; only what the sketch needs is here.
+--- */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <memory>
+#include <string>
+
+typedef bool boolean;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+void *ps_malloc(size_t size);
+
+class String
+{
+private:
+  std::string text;
+
+public:
+  String(const char *c = "") : text(c) {}
+  const char *c_str() const { return text.c_str(); }
+};
+
+class Printable
+{
+public:
+  virtual ~Printable() {}
+  virtual String toString() const = 0;
+};
+
+class IPAddress : public Printable
+{
+public:
+  String toString() const { return String("127.0.0.1"); }
+};
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size)
+  {
+    size_t count = 0;
+    while (size--)
+      count += write(*buffer++);
+    return count;
+  }
+  size_t write(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+  size_t print(const char *s) { return write(s); }
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(const Printable &p) { return print(p.toString()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int n) { return printf("%d", n); }
+  size_t print(unsigned int n) { return printf("%u", n); }
+  size_t print(long n) { return printf("%ld", n); }
+  size_t print(unsigned long n) { return printf("%lu", n); }
+  size_t print(double n, int digits = 2) { return printf("%.*f", digits, n); }
+  size_t println() { return print("\r\n"); }
+  template <typename T> size_t println(const T &value) { size_t count = print(value); return count + println(); }
+};
+
+class Stream : public Print
+{
+protected:
+  unsigned long _timeout = 1000;
+
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+  virtual size_t readBytes(char *buffer, size_t length);
+  virtual size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+  size_t readBytesUntil(char terminator, char *buffer, size_t length);
+};
+
+// Serial reads stdin and writes stdout; Serial1 (the UART of the attached chip) has nothing attached
+class HardwareSerial : public Stream
+{
+private:
+  int fd;
+  int peeked;
+
+public:
+  HardwareSerial(int fd) : fd(fd), peeked(-1) {}
+  void begin(unsigned long baud) {}
+  operator bool() const { return true; }
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override;
+  int availableForWrite() override { return 128; }
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+class EspClass
+{
+public:
+  uint32_t getHeapSize() { return 320 * 1024; }
+  uint32_t getFreeHeap() { return 200 * 1024; }
+  uint32_t getPsramSize() { return 0; }
+  uint32_t getFreePsram() { return 0; }
+};
+
+extern EspClass ESP;
+
+#endif
+
+/*eof*/
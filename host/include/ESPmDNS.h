@@ -0,0 +1,19 @@
+#ifndef __HOST_ESPMDNS_H
+#define __HOST_ESPMDNS_H
+
+// there is no mDNS responder on a host; the services are not announced
+
+#include <stdint.h>
+
+class MDNSResponder
+{
+public:
+  bool begin(const char *hostname) { return true; }
+  void addService(const char *service, const char *proto, uint16_t port) {}
+};
+
+extern MDNSResponder MDNS;
+
+#endif
+
+/*eof*/
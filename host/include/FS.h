@@ -0,0 +1,103 @@
+#ifndef __HOST_FS_H
+#define __HOST_FS_H
+
+/* ***************************************************************************
+* File:    host/include/FS.h
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### HOST FS API
+
+fs::File and fs::FS as in the ESP32 Arduino core 2.0.x: a File forwards to its FileImpl
+(see FSImpl.h) so the storage backends and the filesys cache plug in exactly as on the ESP32.
+--- */
+
+#include "Arduino.h"
+#include <memory>
+#include <time.h>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+namespace fs
+{
+
+class File;
+class FileImpl;
+typedef std::shared_ptr<FileImpl> FileImplPtr;
+class FSImpl;
+typedef std::shared_ptr<FSImpl> FSImplPtr;
+
+enum SeekMode
+{
+  SeekSet = 0,
+  SeekCur = 1,
+  SeekEnd = 2
+};
+
+class File : public Stream
+{
+public:
+  File(FileImplPtr p = FileImplPtr()) : _p(p) {}
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int peek() override;
+  void flush() override;
+  size_t read(uint8_t *buf, size_t size);
+  size_t readBytes(char *buffer, size_t length) override { return read((uint8_t *)buffer, length); }
+  bool seek(uint32_t pos, SeekMode mode);
+  bool seek(uint32_t pos) { return seek(pos, SeekSet); }
+  size_t position() const;
+  size_t size() const;
+  bool setBufferSize(size_t size);
+  void close();
+  operator bool() const;
+  time_t getLastWrite();
+  const char *path() const;
+  const char *name() const;
+  boolean isDirectory(void);
+  File openNextFile(const char *mode = FILE_READ);
+  void rewindDirectory(void);
+  using Print::write;
+
+protected:
+  FileImplPtr _p;
+};
+
+class FS
+{
+public:
+  FS(FSImplPtr impl) : _impl(impl) {}
+
+  File open(const char *path, const char *mode = FILE_READ, const bool create = false);
+  bool exists(const char *path);
+  bool remove(const char *path);
+  bool rename(const char *from, const char *to);
+  bool mkdir(const char *path);
+  bool rmdir(const char *path);
+
+protected:
+  FSImplPtr _impl;
+};
+
+} // namespace fs
+
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif
+
+/*eof*/
@@ -0,0 +1,61 @@
+#ifndef __HOST_FSIMPL_H
+#define __HOST_FSIMPL_H
+
+/* ***************************************************************************
+* File:    host/include/FSImpl.h
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### HOST FSIMPL API
+
+The interfaces behind fs::File and fs::FS, as in the ESP32 Arduino core 2.0.x.
+--- */
+
+#include "FS.h"
+
+namespace fs
+{
+
+class FileImpl
+{
+public:
+  virtual ~FileImpl() {}
+  virtual size_t write(const uint8_t *buf, size_t size) = 0;
+  virtual size_t read(uint8_t *buf, size_t size) = 0;
+  virtual void flush() = 0;
+  virtual bool seek(uint32_t pos, SeekMode mode) = 0;
+  virtual size_t position() const = 0;
+  virtual size_t size() const = 0;
+  virtual bool setBufferSize(size_t size) = 0;
+  virtual void close() = 0;
+  virtual time_t getLastWrite() = 0;
+  virtual const char *path() const = 0;
+  virtual const char *name() const = 0;
+  virtual boolean isDirectory(void) = 0;
+  virtual FileImplPtr openNextFile(const char *mode) = 0;
+  virtual void rewindDirectory(void) = 0;
+  virtual operator bool() = 0;
+};
+
+class FSImpl
+{
+public:
+  virtual ~FSImpl() {}
+  virtual FileImplPtr open(const char *path, const char *mode, const bool create) = 0;
+  virtual bool exists(const char *path) = 0;
+  virtual bool rename(const char *from, const char *to) = 0;
+  virtual bool remove(const char *path) = 0;
+  virtual bool mkdir(const char *path) = 0;
+  virtual bool rmdir(const char *path) = 0;
+};
+
+} // namespace fs
+
+#endif
+
+/*eof*/
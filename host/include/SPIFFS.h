@@ -0,0 +1,36 @@
+#ifndef __HOST_SPIFFS_H
+#define __HOST_SPIFFS_H
+
+/* ***************************************************************************
+* File:    host/include/SPIFFS.h
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+// there is no flash on a host: the SPIFFS never mounts and storage.h uses the host directory backend
+
+#include "FS.h"
+
+namespace fs
+{
+
+class SPIFFSFS : public FS
+{
+public:
+  SPIFFSFS() : FS(FSImplPtr()) {}
+  bool begin(bool formatOnFail = false, const char *basePath = "/spiffs", uint8_t maxOpenFiles = 10, const char *partitionLabel = NULL) { return false; }
+  bool format() { return false; }
+  size_t totalBytes() { return 0; }
+  size_t usedBytes() { return 0; }
+  void end() {}
+};
+
+} // namespace fs
+
+extern fs::SPIFFSFS SPIFFS;
+
+#endif
+
+/*eof*/
@@ -0,0 +1,8 @@
+#ifndef __HOST_WEBSERVER_H
+#define __HOST_WEBSERVER_H
+
+// included by the sketch but not used
+
+#endif
+
+/*eof*/
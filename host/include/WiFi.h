@@ -0,0 +1,97 @@
+#ifndef __HOST_WIFI_H
+#define __HOST_WIFI_H
+
+/* ***************************************************************************
+* File:    host/include/WiFi.h
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### HOST WIFI API
+
+WiFiClient and WiFiServer on plain sockets of the loopback interface, so the TCP and telnet
+servers of the sketch can be driven (and load tested) from the host. The ports are moved up
+by the value of the environment variable HOST_PORT_OFFSET, eg to keep the telnet port above 1024.
+--- */
+
+#include "Arduino.h"
+#include <memory>
+
+#define WIFI_STA     1
+#define WL_CONNECTED 3
+
+// the socket of a client; it is closed with the last WiFiClient which refers to it
+struct hostSocket_s
+{
+  int fd;
+  int peeked;
+  hostSocket_s(int fd) : fd(fd), peeked(-1) {}
+  ~hostSocket_s();
+};
+
+class WiFiClient : public Stream
+{
+private:
+  std::shared_ptr<hostSocket_s> sock;
+
+public:
+  WiFiClient() {}
+  WiFiClient(int fd);
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t *buf, size_t size);
+  int peek() override;
+  void flush() override {}
+  size_t readBytes(char *buffer, size_t length) override { return read((uint8_t *)buffer, length); }
+  uint8_t connected();
+  void stop() { sock.reset(); }
+  operator bool() { return (bool)sock; }
+  bool operator==(const WiFiClient &other) const { return sock == other.sock; }
+  int fd() const { return sock ? sock->fd : -1; }
+  int setNoDelay(bool nodelay);
+  IPAddress remoteIP() const { return IPAddress(); }
+  using Print::write;
+};
+
+class WiFiServer
+{
+private:
+  int listen_fd;
+  int pending_fd;
+  uint16_t port;
+  uint8_t max_clients;  // the listen backlog, as in the ESP32 core
+
+public:
+  WiFiServer(uint16_t port = 80, uint8_t max_clients = 4) : listen_fd(-1), pending_fd(-1), port(port), max_clients(max_clients) {}
+
+  void begin(uint16_t port = 0);
+  void setNoDelay(bool nodelay) {}
+  bool hasClient();
+  WiFiClient available();
+  WiFiClient accept() { return available(); }
+  void end();
+  operator bool() { return listen_fd >= 0; }
+};
+
+class WiFiClass
+{
+public:
+  void mode(int mode) {}
+  void begin(const char *ssid, const char *password) {}
+  int status() { return WL_CONNECTED; }
+  IPAddress localIP() { return IPAddress(); }
+  int channel() { return 0; }
+};
+
+extern WiFiClass WiFi;
+
+#endif
+
+/*eof*/
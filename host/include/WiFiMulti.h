@@ -0,0 +1,10 @@
+#ifndef __HOST_WIFIMULTI_H
+#define __HOST_WIFIMULTI_H
+
+class WiFiMulti
+{
+};
+
+#endif
+
+/*eof*/
@@ -0,0 +1,11 @@
+#ifndef __HOST_DRIVER_DAC_H
+#define __HOST_DRIVER_DAC_H
+
+#define DAC_CHANNEL_1 1
+#define DAC_CHANNEL_2 2
+
+inline void dac_output_disable(int channel) {}
+
+#endif
+
+/*eof*/
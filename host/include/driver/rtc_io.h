@@ -0,0 +1,6 @@
+#ifndef __HOST_DRIVER_RTC_IO_H
+#define __HOST_DRIVER_RTC_IO_H
+
+#endif
+
+/*eof*/
@@ -0,0 +1,8 @@
+#ifndef __HOST_ESP_ADC_CAL_H
+#define __HOST_ESP_ADC_CAL_H
+
+// only used by io.h on the ESP32
+
+#endif
+
+/*eof*/
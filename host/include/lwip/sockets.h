@@ -0,0 +1,19 @@
+#ifndef __HOST_LWIP_SOCKETS_H
+#define __HOST_LWIP_SOCKETS_H
+
+// lwIP numbers its sockets from LWIP_SOCKET_OFFSET; the host sockets are plain file descriptors
+
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define LWIP_SOCKET_OFFSET 0
+
+// the host listens on the ports moved by HOST_PORT_OFFSET (see WiFi.h); the sketch is shown the ports it asked for
+int hostGetSockName(int fd, struct sockaddr *addr, socklen_t *len);
+#define getsockname(fd, addr, len) hostGetSockName(fd, addr, len)
+
+#endif
+
+/*eof*/
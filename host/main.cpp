@@ -0,0 +1,33 @@
+/* ***************************************************************************
+* File:    host/main.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### HOST PROGRAM
+
+The sketch as a host program: setup() once, then loop() forever, as the ESP32 core does.
+Commands are read from stdin (Serial) and from the TCP and telnet ports on the loopback
+interface (see host/include/WiFi.h for HOST_PORT_OFFSET). The files are kept in the directory
+given as the first argument, or in STORAGE_HOST_ROOT.
+--- */
+
+#include "../cmdParser.ino"
+
+int main(int argc, char **argv)
+{
+  if (argc > 1)
+    storageHostRoot(argv[1]);
+
+  setup();
+  for (;;)
+    loop();
+
+  return 0;
+}
+
+/*eof*/
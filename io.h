@@ -11,19 +11,21 @@ int   ioPrint(const char *text);
 int   ioStreamPrint(Stream *out, const char *line);
 int   ioStreamPrintf(Stream *out, const char *fmt, ...);
 bool  ioRunCommandLine(const char *commands, bool aborted, bool wait);
-//bool  ioRunCommandFile(const char *filename, bool wait);
+bool  ioRunCommandFile(const char *filename, bool wait);
 bool  ioRunCommandPrintf(const char *fmt, ...);
 */
 
 // now the local includes
 #include "allincludes.h"
-#include <driver/rtc_io.h>
-#include "esp_adc_cal.h"
+#ifdef ESP32
+  #include <driver/rtc_io.h>
+  #include "esp_adc_cal.h"
+#endif
 
 //#include "screenstream.h"
 //#include "bufferstream.h"
 
-#define MAX_INPUT_BUFFER (8 * 1024) // a command string or the contents of a command file cannot exceed this size
+#define MAX_INPUT_BUFFER (64 * 1024) // a command string or the contents of a command file cannot exceed this size; the buffer grows up to it
 
 class ioStream : public Stream
 {
@@ -86,6 +88,10 @@ public:
   {
     return in->read();
   }
+  virtual size_t readBytes(char *buffer, size_t length)
+  {
+    return in->readBytes(buffer, length);
+  }
   virtual int peek()
   {
     return in->peek();
@@ -175,10 +181,23 @@ int ioStreamPrint(Stream *out, const char *line)
 
 int ioStreamPrintf(Stream *out, const char *fmt...)
 {
-  static char line[MAX_LINE_TEXT + 1];
   va_list args;
   va_start(args, fmt);
 
+  //-- a session's output is formatted straight into its cork
+  corkStream *cork = corkStream::of(out);
+  if (cork)
+  {
+    //-- an error message starts with "Error"; keep alive sessions report it in the status line
+    if (!strncmp(fmt, "Error", 5))
+      cork->error();
+    int len = cork->vprintf(fmt, args);
+    va_end(args);
+    return len;
+  }
+
+  char line[MAX_LINE_TEXT + 1];
+
   line[0] = 0;
   vsnprintf(line, MAX_LINE_TEXT, fmt, args);
   line[MAX_LINE_TEXT - 1] = 0;
@@ -222,35 +241,14 @@ bool ioRunCommandPrintf(const char *fmt, ...)
   return ioRunCommandLine(line, false, false);
 }
 
-/*
-bool ioRunCommandFile(const char *name, bool wait) {
-  // open file. write contents into g_buffer_stream. close file. call parserProcessCommands(g_io_stream);
-  bool success = true;
-  File f = filesysOpen(name, "r");
-
-  if (f) {
-    MESSAGE("Run Command File: %s\n", name);
-
-    while (f.available()) {
-      // we need to process the commands "one line at a time"
-      char line[MAX_LINE_TEXT + 1];
-      uint16_t len = streamReadLine((Stream *)(&f), line, MAX_LINE_TEXT, false);
-      if (len) {
-        FILESYS_STRIP_NL(line, len);
-        if (len) {
-          success = ioRunCommandLine(line, !success, false);
-        }
-      }
-    }
-    filesysClose(f);
-  } else {
-    MESSAGE("Unable to run command file %s\n", name);
-  }
-  if (wait)
-    ioWaitForButton(true);
-  return true;
+bool ioRunCommandFile(const char *name, bool wait)
+{
+  // the file is parsed once and cached by the parser; there is no button to wait for on this build
+  MESSAGE("Run Command File: %s\n", name);
+  return parserRunCommandFile(g_io_stream, name, false);
 }
 
+/*
 const char *ioGetBatteryInfo() {
 
 #if 0 // used to debug actual VREF
@@ -0,0 +1,334 @@
+#ifndef __LOG_H
+#define __LOG_H
+
+/* ***************************************************************************
+* File:    log
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### LOG API
+
+A deferred log. logRecord() does not format anything and does not touch the UART; it keeps
+the format pointer, the time and the raw arguments in a RAM ring of LOG_RECORDS entries.
+Strings are copied into the record (up to LOG_TEXT_LEN bytes for all strings of a record)
+because the caller's buffer may change before the record is formatted. A string which is cut
+ends in "...".
+
+The records are formatted later: logLoop() sends them to DEBUGSERIAL while the UART has room
+for them, and the `LOG` command dumps the whole ring to the client. When the ring is full the
+oldest records are overwritten; logLoop() reports how many it has missed.
+
+Recording is lock free so any task may log. A record is claimed with an atomic increment
+and marked complete with its sequence number; a reader which finds the sequence changed
+while it copied the record skips it.
+
+The `DEBUG`, `VERBOSE` and `MESSAGE` macros record at their LOG_LEVEL_xxx; the levels and
+LOG_LEVEL are in allincludes.h. Macros above LOG_LEVEL compile to nothing.
+
+_NOTE: The format must be a string constant. Supported are the usual conversions with flags,
+width and precision; a `*` width or precision is not supported._
+--- */
+
+#include <atomic>
+
+#define LOG_RECORDS   64 // a power of two
+#define LOG_ARG_WORDS 6  // 32 bit words for the arguments; a double or a 64 bit value takes two
+#define LOG_TEXT_LEN  96 // the string arguments of a record are kept up to this length; file names and usual command lines fit
+#define LOG_LINE_LEN  160
+#define LOG_UART_ROOM 64 // free space of the UART which lets logLoop() send a record; the TX FIFO of the ESP32 holds 128
+
+#define LOG_ARG_INT  0
+#define LOG_ARG_WIDE 1 // 64 bits
+#define LOG_ARG_DBL  2
+#define LOG_ARG_STR  3
+#define LOG_ARG_NONE 4 // "%%"
+#define LOG_ARG_BAD  5 // the end of the format or a conversion which is not supported
+
+typedef struct
+{
+  std::atomic<uint32_t> seq;       // the sequence number + 1 once the record is complete; 0 while it is written
+  const char *fmt;
+  uint32_t time;                   // millis()
+  uint8_t level;
+  uint8_t words;
+  uint32_t args[LOG_ARG_WORDS];
+  char text[LOG_TEXT_LEN];         // the strings; a string arg is its offset in here
+} logRecord_t;
+
+static logRecord_t _log_ring[LOG_RECORDS];
+static std::atomic<uint32_t> _log_head(0); // the sequence number of the next record
+static uint32_t _log_drained = 0;           // the next record for logLoop()
+
+static_assert((LOG_RECORDS & (LOG_RECORDS - 1)) == 0, "LOG_RECORDS must be a power of two");
+static_assert(LOG_TEXT_LEN <= 256, "a string arg is a uint8_t offset into the text");
+
+//--------------------------------------------------------------------
+// step over one conversion; returns its LOG_ARG_xxx
+static uint8_t _logSpec(const char **format)
+{
+  const char *f = *format + 1; // after the '%'
+  if (*f == '%')
+  {
+    *format = f + 1;
+    return LOG_ARG_NONE;
+  }
+  while (*f && strchr("-+ #0123456789.", *f))
+    f++;
+  int longs = 0;
+  bool size = false;
+  while (*f && strchr("hlLqjzt", *f))
+  {
+    longs += (*f == 'l') || (*f == 'q') || (*f == 'L');
+    size |= (*f == 'z') || (*f == 'j') || (*f == 't');
+    f++;
+  }
+  char conv = *f;
+  *format = conv ? f + 1 : f;
+  switch (conv)
+  {
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+      if ((longs > 1) || ((longs == 1) && (sizeof(long) > 4)) || (size && (sizeof(size_t) > 4)))
+        return LOG_ARG_WIDE;
+      return LOG_ARG_INT;
+    case 'p':
+      return (sizeof(void *) > 4) ? LOG_ARG_WIDE : LOG_ARG_INT;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+      return LOG_ARG_DBL;
+    case 's':
+      return LOG_ARG_STR;
+  }
+  return LOG_ARG_BAD;
+}
+
+/* ---
+#### logRecord()
+
+Keep a log record; it is formatted later. Use the DEBUG(), VERBOSE() and MESSAGE() macros.
+
+- input: level **uint8_t** LOG_LEVEL_xxx
+- input: fmt **char ptr** a printf() format; it must stay valid, eg a string constant
+--- */
+void logRecord(uint8_t level, const char *fmt, ...)
+{
+  uint32_t seq = _log_head.fetch_add(1, std::memory_order_relaxed);
+  logRecord_t *record = &(_log_ring[seq & (LOG_RECORDS - 1)]);
+  record->seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  record->fmt = fmt;
+  record->time = millis();
+  record->level = level;
+
+  va_list args;
+  va_start(args, fmt);
+  uint8_t words = 0;
+  uint8_t text = 0;
+  const char *f = fmt;
+  while ((f = strchr(f, '%')))
+  {
+    uint8_t type = _logSpec(&f);
+    if (type == LOG_ARG_NONE)
+      continue;
+    if ((type == LOG_ARG_BAD) || ((words + ((type == LOG_ARG_INT) || (type == LOG_ARG_STR) ? 1 : 2)) > LOG_ARG_WORDS))
+      break;
+    switch (type)
+    {
+      case LOG_ARG_INT:
+        record->args[words++] = va_arg(args, unsigned int);
+        break;
+      case LOG_ARG_WIDE:
+      {
+        uint64_t value = va_arg(args, uint64_t);
+        memcpy(&(record->args[words]), &value, sizeof(value));
+        words += 2;
+      } break;
+      case LOG_ARG_DBL:
+      {
+        double value = va_arg(args, double);
+        memcpy(&(record->args[words]), &value, sizeof(value));
+        words += 2;
+      } break;
+      case LOG_ARG_STR:
+      {
+        //-- the last byte of text is always 0; a string which does not fit is cut and ends in "..."
+        const char *s = va_arg(args, const char *);
+        if (!s)
+          s = "(null)";
+        record->args[words++] = text;
+        uint8_t first = text;
+        while (*s && (text < (LOG_TEXT_LEN - 1)))
+          record->text[text++] = *s++;
+        if (*s && ((text - first) >= 3))
+          memcpy(record->text + text - 3, "...", 3);
+        record->text[text] = 0;
+        if (text < (LOG_TEXT_LEN - 1))
+          text++;
+      } break;
+    }
+  }
+  va_end(args);
+  record->words = words;
+
+  record->seq.store(seq + 1, std::memory_order_release);
+}
+
+//--------------------------------------------------------------------
+// copy the record with the sequence number; false when it has been overwritten or is not complete
+static bool _logCopy(uint32_t seq, logRecord_t *copy)
+{
+  logRecord_t *record = &(_log_ring[seq & (LOG_RECORDS - 1)]);
+  if (record->seq.load(std::memory_order_acquire) != (seq + 1))
+    return false;
+  copy->fmt = record->fmt;
+  copy->time = record->time;
+  copy->level = record->level;
+  copy->words = record->words;
+  memcpy(copy->args, record->args, sizeof(copy->args));
+  memcpy(copy->text, record->text, sizeof(copy->text));
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return (record->seq.load(std::memory_order_relaxed) == (seq + 1));
+}
+
+/* ---
+#### logFormat()
+
+Format a record one conversion at a time.
+
+- input: record **logRecord_t ptr** a copy of a record
+- input: buf **char ptr** storage for the text; LOG_LINE_LEN is enough for most records
+- input: size **size_t** the size of the storage
+- return: **int** the length of the text
+--- */
+int logFormat(const logRecord_t *record, char *buf, size_t size)
+{
+  char spec[16];
+  uint8_t word = 0;
+  size_t len = snprintf(buf, size, "%8u ", record->time);
+  const char *f = record->fmt;
+  while (*f && (len < (size - 1)))
+  {
+    if (*f != '%')
+    {
+      buf[len++] = *f++;
+      continue;
+    }
+    const char *start = f;
+    uint8_t type = _logSpec(&f);
+    if (type == LOG_ARG_NONE)
+    {
+      buf[len++] = '%';
+      continue;
+    }
+    if ((type == LOG_ARG_BAD) || (word >= record->words) || ((size_t)(f - start) >= sizeof(spec)))
+      break;
+    memcpy(spec, start, f - start);
+    spec[f - start] = 0;
+
+    int count = 0;
+    switch (type)
+    {
+      case LOG_ARG_INT:
+        count = snprintf(buf + len, size - len, spec, record->args[word++]);
+        break;
+      case LOG_ARG_WIDE:
+      {
+        uint64_t value;
+        memcpy(&value, &(record->args[word]), sizeof(value));
+        word += 2;
+        count = snprintf(buf + len, size - len, spec, value);
+      } break;
+      case LOG_ARG_DBL:
+      {
+        double value;
+        memcpy(&value, &(record->args[word]), sizeof(value));
+        word += 2;
+        count = snprintf(buf + len, size - len, spec, value);
+      } break;
+      case LOG_ARG_STR:
+        count = snprintf(buf + len, size - len, spec, record->text + record->args[word++]);
+        break;
+    }
+    if (count > 0)
+      len += count;
+  }
+  if (len >= size)
+    len = size - 1;
+  buf[len] = 0;
+  return len;
+}
+
+/* ---
+#### logDump()
+
+Send the records which are in the ring, the oldest first.
+
+- input: out **Stream ptr** the destination
+- input: level **uint8_t** records above this LOG_LEVEL_xxx are skipped
+- return: **uint16_t** the number of records sent
+--- */
+uint16_t logDump(Stream *out, uint8_t level)
+{
+  logRecord_t record;
+  char line[LOG_LINE_LEN + 1];
+  uint16_t count = 0;
+  uint32_t head = _log_head.load(std::memory_order_acquire);
+  uint32_t seq = (head > LOG_RECORDS) ? (head - LOG_RECORDS) : 0;
+  for (; seq != head; seq++)
+  {
+    if (!_logCopy(seq, &record) || (record.level > level))
+      continue;
+    int len = logFormat(&record, line, sizeof(line) - 1);
+    if (len && (line[len - 1] != '\n'))
+      line[len++] = '\n';
+    out->write((uint8_t *)line, len);
+    count++;
+  }
+  return count;
+}
+
+/* ---
+#### logLoop()
+
+Send new records to DEBUGSERIAL without waiting long for the UART; a record is only formatted
+when the UART has LOG_UART_ROOM bytes free. That is less than LOG_LINE_LEN, as the TX FIFO
+of the ESP32 is smaller than a line, so a long line may wait for a few characters. Call it from loop().
+--- */
+void logLoop()
+{
+  logRecord_t record;
+  char line[LOG_LINE_LEN + 1];
+  uint32_t head = _log_head.load(std::memory_order_acquire);
+
+  if ((head - _log_drained) > LOG_RECORDS)
+  {
+    DEBUGSERIAL.printf("LOG: %u records lost\n", (head - _log_drained) - LOG_RECORDS);
+    _log_drained = head - LOG_RECORDS;
+  }
+  while ((_log_drained != head) && (DEBUGSERIAL.availableForWrite() >= LOG_UART_ROOM))
+  {
+    if (_logCopy(_log_drained, &record))
+    {
+      int len = logFormat(&record, line, sizeof(line) - 1);
+      if (len && (line[len - 1] != '\n'))
+        line[len++] = '\n';
+      DEBUGSERIAL.write((uint8_t *)line, len);
+    }
+    else
+    {
+      //-- a record which is still being written stops the loop; an overwritten one is skipped
+      uint32_t stored = _log_ring[_log_drained & (LOG_RECORDS - 1)].seq.load(std::memory_order_acquire);
+      if (!stored || ((int32_t)(stored - (_log_drained + 1)) < 0))
+        break;
+    }
+    _log_drained++;
+  }
+}
+
+#endif
+
+/*eof*/
@@ -0,0 +1,399 @@
+#ifndef __LZSTREAM_H
+#define __LZSTREAM_H
+
+/* ***************************************************************************
+* File:    lzstream
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### LZSTREAM API
+
+A streaming LZSS codec with a 4 KB window. Both directions work incrementally on
+caller supplied buffers of any size, so a transfer never needs the whole file in memory.
+The encoder needs about 20 KB of heap and the decoder 4 KB; both are allocated by Begin()
+and released by End().
+
+The compressed stream is the 4 byte magic `LZS1` followed by groups of one flag byte and
+up to 8 items. Flag bit `n` (LSB first) tells if item `n` is a literal byte (0) or a match (1).
+A match is 2 bytes: the low 8 bits of `offset - 1`, then the high 4 bits of `offset - 1` and `length - 3`.
+The stream simply ends after the last item.
+--- */
+
+#define LZ_WINDOW        4096 // the furthest a match may reach back
+#define LZ_MIN_MATCH     3
+#define LZ_MAX_MATCH     18
+#define LZ_MAX_EXPANSION 9    // the most bytes produced by the decoder for one compressed byte
+#define LZ_HASH_BITS     12
+#define LZ_CHAIN         16   // the most match candidates tried per position; more is slower and smaller
+#define LZ_NIL           0xFFFF
+
+static const uint8_t _lz_magic[4] = {'L', 'Z', 'S', '1'};
+
+typedef struct
+{
+  uint8_t *window;    // 2 * LZ_WINDOW; the encoded history and the lookahead
+  uint16_t *head;     // most recent position of each hash
+  uint16_t *prev;     // the previous position with the same hash; indexed by position % LZ_WINDOW
+  uint16_t fill;      // bytes in the window
+  uint16_t pos;       // the next byte to encode
+  uint8_t group[1 + (8 * 2)];
+  uint8_t group_len;  // bytes in the group; 0 when no group is started
+  uint8_t group_items;
+  uint8_t group_out;  // bytes of a completed group already handed out
+  bool group_ready;
+} lzEncoder_t;
+
+typedef struct
+{
+  uint8_t *window;    // LZ_WINDOW ring of the most recent output
+  uint32_t total;     // bytes produced
+  uint8_t header;     // magic bytes seen
+  uint8_t flags;
+  uint8_t flag_bits;  // items left in the current group
+  uint8_t match_lo;
+  bool have_lo;
+  uint16_t copy_from; // a match which is being copied
+  uint8_t copy_len;
+  bool error;         // the stream is not valid; the rest is ignored
+} lzDecoder_t;
+
+
+// -------- encoder --------------------------------------------------------------------
+
+static uint16_t _lzHash(const uint8_t *p)
+{
+  return ((p[0] << 8) ^ (p[1] << 4) ^ p[2]) & ((1 << LZ_HASH_BITS) - 1);
+}
+
+static void _lzInsert(lzEncoder_t *enc, uint16_t pos)
+{
+  if ((pos + LZ_MIN_MATCH) > enc->fill)
+    return;
+  uint16_t hash = _lzHash(enc->window + pos);
+  enc->prev[pos & (LZ_WINDOW - 1)] = enc->head[hash];
+  enc->head[hash] = pos;
+}
+
+// drop the oldest LZ_WINDOW bytes; the positions in the hash tables move with the data
+static void _lzSlide(lzEncoder_t *enc)
+{
+  memmove(enc->window, enc->window + LZ_WINDOW, enc->fill - LZ_WINDOW);
+  enc->fill -= LZ_WINDOW;
+  enc->pos -= LZ_WINDOW;
+  for (int i = 0; i < (1 << LZ_HASH_BITS); i++)
+    enc->head[i] = ((enc->head[i] != LZ_NIL) && (enc->head[i] >= LZ_WINDOW)) ? (enc->head[i] - LZ_WINDOW) : LZ_NIL;
+  for (int i = 0; i < LZ_WINDOW; i++)
+    enc->prev[i] = ((enc->prev[i] != LZ_NIL) && (enc->prev[i] >= LZ_WINDOW)) ? (enc->prev[i] - LZ_WINDOW) : LZ_NIL;
+}
+
+// the longest match for the bytes at pos; returns the length and sets the offset
+static uint8_t _lzMatch(lzEncoder_t *enc, uint16_t *offset)
+{
+  uint16_t pos = enc->pos;
+  uint16_t avail = enc->fill - pos;
+  if (avail < LZ_MIN_MATCH)
+    return 0;
+  uint8_t limit = (avail < LZ_MAX_MATCH) ? avail : LZ_MAX_MATCH;
+
+  uint8_t best = 0;
+  uint16_t candidate = enc->head[_lzHash(enc->window + pos)];
+  for (int chain = 0; (chain < LZ_CHAIN) && (candidate != LZ_NIL) && (candidate < pos) && ((pos - candidate) <= LZ_WINDOW); chain++)
+  {
+    const uint8_t *a = enc->window + candidate;
+    const uint8_t *b = enc->window + pos;
+    uint8_t len = 0;
+    while ((len < limit) && (a[len] == b[len]))
+      len++;
+    if (len > best)
+    {
+      best = len;
+      *offset = pos - candidate;
+      if (best == limit)
+        break;
+    }
+    uint16_t older = enc->prev[candidate & (LZ_WINDOW - 1)];
+    //-- a chain entry which has been reused by a newer position ends the chain
+    if ((older != LZ_NIL) && (older >= candidate))
+      break;
+    candidate = older;
+  }
+  return (best >= LZ_MIN_MATCH) ? best : 0;
+}
+
+/* ---
+#### lzEncoderEnd()
+
+- input: enc **lzEncoder_t ptr** an encoder; its memory is released
+--- */
+void lzEncoderEnd(lzEncoder_t *enc)
+{
+  free(enc->window);
+  free(enc->head);
+  free(enc->prev);
+  enc->window = NULL;
+  enc->head = NULL;
+  enc->prev = NULL;
+}
+
+/* ---
+#### lzEncoderBegin()
+
+- input: enc **lzEncoder_t ptr** the encoder storage; it is owned by the caller
+- return: **bool** `true` on success and `false` when there is not enough memory
+--- */
+bool lzEncoderBegin(lzEncoder_t *enc)
+{
+  enc->window = (uint8_t *)malloc(2 * LZ_WINDOW);
+  enc->head = (uint16_t *)malloc((1 << LZ_HASH_BITS) * sizeof(uint16_t));
+  enc->prev = (uint16_t *)malloc(LZ_WINDOW * sizeof(uint16_t));
+  if (!enc->window || !enc->head || !enc->prev)
+  {
+    lzEncoderEnd(enc);
+    return false;
+  }
+  memset(enc->head, 0xFF, (1 << LZ_HASH_BITS) * sizeof(uint16_t));
+  memset(enc->prev, 0xFF, LZ_WINDOW * sizeof(uint16_t));
+  enc->fill = 0;
+  enc->pos = 0;
+  //-- the magic goes out as the first "group"
+  memcpy(enc->group, _lz_magic, sizeof(_lz_magic));
+  enc->group_len = sizeof(_lz_magic);
+  enc->group_items = 0;
+  enc->group_out = 0;
+  enc->group_ready = true;
+  return true;
+}
+
+/* ---
+#### lzEncode()
+
+Compress as much of the input as fits and return the compressed bytes which fit in the output.
+Call it again with the rest of the input (and more output room) until all input is taken.
+The last bytes are only encoded with `finish`; keep calling with `finish` until it returns 0.
+
+- input: enc **lzEncoder_t ptr** an encoder
+- input: in **uint8_t ptr** the data to compress
+- input: in_len **size_t ptr** the number of bytes of input; it returns the number of bytes taken
+- input: out **uint8_t ptr** storage for compressed bytes
+- input: out_len **size_t** the size of the storage
+- input: finish **bool** there is no more input after this
+- return: **size_t** the number of compressed bytes in the output
+--- */
+size_t lzEncode(lzEncoder_t *enc, const uint8_t *in, size_t *in_len, uint8_t *out, size_t out_len, bool finish)
+{
+  size_t taken = 0;
+  size_t produced = 0;
+
+  while (true)
+  {
+    if (enc->group_ready)
+    {
+      size_t count = enc->group_len - enc->group_out;
+      if (count > (out_len - produced))
+        count = out_len - produced;
+      memcpy(out + produced, enc->group + enc->group_out, count);
+      produced += count;
+      enc->group_out += count;
+      if (enc->group_out < enc->group_len)
+        break; // the output is full
+      enc->group_ready = false;
+      enc->group_len = 0;
+      enc->group_items = 0;
+      enc->group_out = 0;
+    }
+
+    //-- keep the window topped up
+    if ((enc->fill == (2 * LZ_WINDOW)) && (enc->pos >= ((2 * LZ_WINDOW) - LZ_MAX_MATCH)))
+      _lzSlide(enc);
+    if ((taken < *in_len) && (enc->fill < (2 * LZ_WINDOW)))
+    {
+      size_t count = (2 * LZ_WINDOW) - enc->fill;
+      if (count > (*in_len - taken))
+        count = *in_len - taken;
+      memcpy(enc->window + enc->fill, in + taken, count);
+      enc->fill += count;
+      taken += count;
+    }
+
+    //-- without a full lookahead we wait for more input unless this is the end
+    uint16_t avail = enc->fill - enc->pos;
+    if ((!finish || (taken < *in_len)) && (avail < LZ_MAX_MATCH))
+      break;
+    if (!avail)
+    {
+      if (enc->group_len)
+      {
+        enc->group_ready = true; // the partial last group
+        continue;
+      }
+      break;
+    }
+
+    if (!enc->group_len)
+    {
+      enc->group[0] = 0;
+      enc->group_len = 1;
+    }
+
+    uint16_t offset = 0;
+    uint8_t len = _lzMatch(enc, &offset);
+    if (len)
+    {
+      enc->group[0] |= (1 << enc->group_items);
+      enc->group[enc->group_len++] = (offset - 1) & 0xFF;
+      enc->group[enc->group_len++] = (((offset - 1) >> 8) << 4) | (len - LZ_MIN_MATCH);
+    }
+    else
+    {
+      len = 1;
+      enc->group[enc->group_len++] = enc->window[enc->pos];
+    }
+    for (uint8_t i = 0; i < len; i++)
+      _lzInsert(enc, enc->pos++);
+
+    if (++enc->group_items == 8)
+      enc->group_ready = true;
+  }
+
+  *in_len = taken;
+  return produced;
+}
+
+// -------- decoder --------------------------------------------------------------------
+
+/* ---
+#### lzDecoderBegin()
+
+- input: dec **lzDecoder_t ptr** the decoder storage; it is owned by the caller
+- return: **bool** `true` on success and `false` when there is not enough memory
+--- */
+bool lzDecoderBegin(lzDecoder_t *dec)
+{
+  dec->window = (uint8_t *)malloc(LZ_WINDOW);
+  dec->total = 0;
+  dec->header = 0;
+  dec->flag_bits = 0;
+  dec->have_lo = false;
+  dec->copy_len = 0;
+  dec->error = false;
+  return (dec->window != NULL);
+}
+
+/* ---
+#### lzDecode()
+
+Decompress as much of the input as fits in the output.
+Call it again with the rest of the input when the output was full.
+
+- input: dec **lzDecoder_t ptr** a decoder
+- input: in **uint8_t ptr** compressed data
+- input: in_len **size_t ptr** the number of bytes of input; it returns the number of bytes taken
+- input: out **uint8_t ptr** storage for the data
+- input: out_len **size_t** the size of the storage
+- return: **size_t** the number of bytes in the output; check `dec->error` for an invalid stream
+--- */
+size_t lzDecode(lzDecoder_t *dec, const uint8_t *in, size_t *in_len, uint8_t *out, size_t out_len)
+{
+  size_t taken = 0;
+  size_t produced = 0;
+
+  while (!dec->error)
+  {
+    if (dec->copy_len)
+    {
+      if (produced == out_len)
+        break;
+      uint8_t c = dec->window[dec->copy_from];
+      dec->copy_from = (dec->copy_from + 1) & (LZ_WINDOW - 1);
+      dec->copy_len--;
+      dec->window[dec->total++ & (LZ_WINDOW - 1)] = c;
+      out[produced++] = c;
+      continue;
+    }
+
+    if (taken == *in_len)
+      break;
+    uint8_t c = in[taken];
+
+    if (dec->header < sizeof(_lz_magic))
+    {
+      if (c != _lz_magic[dec->header++])
+        dec->error = true;
+      taken++;
+      continue;
+    }
+
+    if (!dec->flag_bits)
+    {
+      dec->flags = c;
+      dec->flag_bits = 8;
+      taken++;
+      continue;
+    }
+
+    if (!(dec->flags & 1))
+    {
+      //-- literal
+      if (produced == out_len)
+        break;
+      dec->window[dec->total++ & (LZ_WINDOW - 1)] = c;
+      out[produced++] = c;
+    }
+    else if (!dec->have_lo)
+    {
+      dec->match_lo = c;
+      dec->have_lo = true;
+      taken++;
+      continue;
+    }
+    else
+    {
+      uint16_t offset = (dec->match_lo | ((c >> 4) << 8)) + 1;
+      dec->have_lo = false;
+      if (offset > dec->total)
+        dec->error = true; // it reaches back before the start of the data
+      dec->copy_from = (dec->total - offset) & (LZ_WINDOW - 1);
+      dec->copy_len = (c & 0x0F) + LZ_MIN_MATCH;
+    }
+    taken++;
+    dec->flags >>= 1;
+    dec->flag_bits--;
+  }
+
+  *in_len = taken;
+  return produced;
+}
+
+/* ---
+#### lzDecoderEnd()
+
+- input: dec **lzDecoder_t ptr** a decoder; its memory is released
+- return: **bool** `true` when the stream was valid and ended on an item boundary
+--- */
+bool lzDecoderEnd(lzDecoder_t *dec)
+{
+  free(dec->window);
+  dec->window = NULL;
+  return (!dec->error && (dec->header == sizeof(_lz_magic)) && !dec->have_lo && !dec->copy_len);
+}
+
+/* ---
+#### lzIsCompressed()
+
+- input: data **uint8_t ptr** the start of a file or stream
+- input: len **size_t** the number of bytes
+- return: **bool** `true` when the data starts with the magic of a compressed stream
+--- */
+bool lzIsCompressed(const uint8_t *data, size_t len)
+{
+  return ((len >= sizeof(_lz_magic)) && (memcmp(data, _lz_magic, sizeof(_lz_magic)) == 0));
+}
+
+#endif
+
+/*eof*/
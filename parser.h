@@ -47,12 +47,24 @@ static avrDevice _parser_device_funcs;
 #define PARSER_CMD_HELP    0 // this needs to be the first command ID
 // setup / config commands
 #define PARSER_CMD_INFO    1
+#define PARSER_CMD_LOG     2
+#define PARSER_CMD_KEEPALIVE 3
 
 // file commands
 #define PARSER_CMD_DIR     11
 #define PARSER_CMD_DEL     12
 #define PARSER_CMD_CAT     13
 #define PARSER_CMD_UPLOAD  14
+#define PARSER_CMD_UPLOADTXT 15
+#define PARSER_CMD_CATTXT  16
+#define PARSER_CMD_SIZE    17
+#define PARSER_CMD_ZUPLOAD 18
+#define PARSER_CMD_ZCAT    19
+#define PARSER_CMD_HASH    20
+#define PARSER_CMD_VERIFY  21
+#define PARSER_CMD_HEXINFO 22
+#define PARSER_CMD_RUN     23
+#define PARSER_CMD_SYNC    24
 
 
 
@@ -63,50 +75,278 @@ typedef struct
   const char *parms;
   const char *desc;
   uint8_t args;
+  uint8_t opt_args; // optional args which follow the required args; they are only taken from the same line
   bool has_stream;  // need to know this in case we attempt to skip the command
   bool abortable;   // command is skipped when abort is active
 } parserCmd_t;
 
+
+// -------- parser sessions --------------------------------------------------------------------
+#define PARSER_CHUNK_SIZE 2048 // input is taken from the client in chunks of up to this size
+#define PARSER_SEND_CHUNK 1436 // file content is sent in chunks of one TCP MSS
+#define PARSER_SEND_BURST 8    // the most chunks sent by one poll
+#define PARSER_LZ_BLOCK   512  // compressed transfers are (de)compressed in blocks of this size
+
+/*
+  the loop task has an 8 KB stack, so the buffers of the parser are not on it: the input chunk belongs to
+  the session and the send and (de)compression buffers are shared by all sessions. the parser runs on
+  the loop task only and a send or a stream write never calls back into the parser, so the shared
+  buffers are never in use twice.
+*/
+static uint8_t _parser_send_chunk[PARSER_SEND_CHUNK];
+static uint8_t _parser_lz_block[PARSER_LZ_BLOCK];
+
+// what happens with the data of a stream command
+#define PARSER_STREAM_DISCARD 0  // the command failed or was aborted
+#define PARSER_STREAM_RAW     1  // stored exactly as received
+#define PARSER_STREAM_TEXT    2  // stored without '\r', '\0' and leading white space
+#define PARSER_STREAM_LZ      3  // decompressed and stored
+
+// -------- command files --------------------------------------------------------------------
+#define PARSER_PROGRAM_CACHE 4 // compiled command files which are kept
+#define PARSER_RUN_DEPTH     3 // command files may RUN other command files up to this depth
+#define PARSER_COMPILE_CHUNK 512 // a command file is compiled from chunks of this size
+
+/*
+  a command file is compiled once into a list of steps; the args of all steps are
+  kept as strings in a single pool. the cache entry is reused while the file has
+  the same size and modification time
+*/
+typedef struct
+{
+  uint8_t cmd;                   // index into _parser_commands[]
+  uint8_t args;
+  uint16_t arg_offset;           // the args of the step in the pool
+} parserStep_t;
+
+typedef struct
+{
+  char name[MAX_FILENAME_LEN + 1]; // empty when the entry is not in use
+  uint32_t size;
+  time_t mtime;
+  parserStep_t *steps;
+  uint16_t step_count;
+  uint16_t step_room;
+  char *pool;
+  uint16_t pool_len;
+  uint16_t pool_room;
+  bool failed;                   // the file did not compile
+  uint8_t running;               // nested runs of the program; it is not released while it runs
+  bool stale;                    // the file changed while the program ran; it is released afterwards
+  uint32_t last_used;
+} parserProgram_t;
+
+/*
+  a session holds the complete parser state between calls to parserSessionPoll()
+  the input may arrive in any number of pieces; a token which is split across
+  reads is continued on the next poll
+*/
+typedef struct
+{
+  Stream *client;                // NULL when the session is not active; the cork of the Stream while it is
+  corkStream cork;               // the output is collected and sent at the end of each poll
+  const parserCmd_t *active_cmd;
+  int8_t command_id;
+  int8_t args;                   // number of args received for the active command
+  bool expecting_args;
+  bool abort_processing;
+  bool streaming;                // the active command consumes all remaining data of the session
+  bool skip_line;                // the rest of the command line is dropped before the stream starts
+  uint8_t stream_mode;           // PARSER_STREAM_xxx
+  char delimiter;                // the character which ended the most recent token
+  uint16_t len;
+  uint16_t token_start;          // args are collected in the linebuffer; this is where the current one starts
+  char linebuffer[MAX_NETWORK_TEXT + 1 + 1]; // buffer + ' ' + 0
+  uint8_t *input;                // PARSER_CHUNK_SIZE bytes for the input; allocated by the first poll which reads
+  uint16_t input_pos;            // the input from here to input_len has not been parsed; it waits for the output of a command
+  uint16_t input_len;
+  uint32_t data_size_processed;
+  uint32_t stream_start;         // millis() when the stream started
+  uint32_t stream_compressed;    // compressed bytes received by a PARSER_STREAM_LZ stream
+  lzDecoder_t lz_decoder;
+  bool sending;                  // file content is being sent to the client
+  File send_file;
+  uint32_t send_remaining;
+  bool send_lz;                  // the file content is compressed while it is sent
+  lzEncoder_t lz_encoder;
+  uint8_t *send_buf;             // compressed content which has not been sent
+  uint16_t send_fill;
+  uint16_t send_done;
+  parserProgram_t *program;      // commands are compiled into the program instead of being executed
+  bool keep_alive;               // every response ends with a status line; see KEEPALIVE
+  bool responding;               // a command has started and its status line has not been sent
+  uint32_t response_start;       // the byte count of the cork when the response started
+  uint16_t response_errors;      // the error count of the cork when the response started
+} parserSession_t;
+
+void parserSessionBegin(parserSession_t *session, Stream *client, bool aborted, uint8_t *out_buf = NULL);
+bool parserSessionPoll(parserSession_t *session);
+bool parserSessionEnd(parserSession_t *session);
+bool parserSessionBusy(parserSession_t *session);
+bool parserSessionKeepAlive(parserSession_t *session);
+bool parserRunCommandFile(Stream *client, const char *name, bool aborted);
+
+static void _parserProgramForget(const char *name);
+
 // FYI: If you are wondering why the above #defines are added to the data structure it's because I kept reordering the help text and forgetting to renumber the defines
+// the static_assert()s below the table catch a duplicate id or name and a HELP command which is not the first entry
 
 
 
-static parserCmd_t _parser_commands[] =
+static constexpr parserCmd_t _parser_commands[] =
 {
-  // id, command name, parameters, help text, parm count
+  // id, command name, parameters, help text, parm count, optional parm count
 
   /* ---
     - `HELP`: returns the help text
   --- */
-  {PARSER_CMD_HELP, "HELP", "", "return help text", 0, false, false},
+  {PARSER_CMD_HELP, "HELP", "", "return help text", 0, 0, false, false},
   /* ---
     - `INFO`:  for testing.
   --- */
-  {PARSER_CMD_INFO, "INFO", "", "return chip information", 2, false, true},
+  {PARSER_CMD_INFO, "INFO", "", "return chip information", 2, 0, false, true},
+  /* ---
+    - `LOG` [level]: send the records of the log ring, the oldest first. Records above the level
+    (1 messages, 2 debug, 3 verbose) are skipped; the default is all records.
+  --- */
+  {PARSER_CMD_LOG, "LOG", "[level]", "return the recent log", 0, 1, false, true},
+  /* ---
+    - `KEEPALIVE` [OFF]: keep the TCP connection open between commands. Every response then ends with a
+    status line `=OK <length>` or `=ERR <length>`, where the length is the number of bytes of the response
+    before the status line. A client can pipeline many newline terminated commands over one connection and
+    find the end of each response, even of binary `CAT` output. `OFF` returns to one command batch per connection.
+    _NOTE: A stream command (eg `UPLOAD`) still takes the rest of the connection; its status line follows when the client closes its side._
+  --- */
+  {PARSER_CMD_KEEPALIVE, "KEEPALIVE", "[OFF]", "keep the connection; responses end with a status line", 0, 1, false, false},
   /* ---
   - `DEL` <filename>: Delete the named file from the SPIFFS.
 --- */
-  {PARSER_CMD_DEL, "DEL", "<name>", "delete file from SPIFFS", 1, false, true},
+  {PARSER_CMD_DEL, "DEL", "<name>", "delete file from SPIFFS", 1, 0, false, true},
 /* ---
   - `CAT` <filename>: stream contents of file from the SPIFFS back to the local computer standard output.
+  The content is sent exactly as stored, so binary files are safe.
+  The optional `offset` and `length` select a part of the file; this lets a client resume an interrupted download.
+--- */
+  {PARSER_CMD_CAT, "CAT", "<name> [offset [length]]", "stream contents of file", 1, 2, false, true},
+/* ---
+  - `CATTXT` <filename>: stream a text file line by line; carriage returns are removed.
 --- */
-  {PARSER_CMD_CAT, "CAT", "<name>", "stream contents of file", 1, false, true},
+  {PARSER_CMD_CATTXT, "CATTXT", "<name>", "stream contents of text file", 1, 0, false, true},
 /* ---
   - `UPLOAD` <filename> (stream): create a new file in the SPIFFS and store the contents of the stream to the file.
   The `stream` is whatever content is send over TCP to the PortaProg. A common method is to pipe the standard output of a command to TCP.
   For example, to send the contents of a file to standard output, use the Linux `cat` command or the windows `type` command.
     This is a general purpose file operation and no analysis is performed to determine the contents.
+  The stream starts on the line after the command and is stored byte for byte, so binary files are safe.
+  When the upload completes the byte count and throughput are reported.
+  The optional `offset` stores the stream from that position of an existing file and `APPEND` stores it at the end.
+  Together with `SIZE` this lets a client resume an interrupted upload: it sends the remainder from the reported size.
   The primary use of the `UPLOAD` command is to store `CMD` files on the SPIFFS but it is available to store any file.
   _NOTE: The command will consume all data available from the stream. It is not possible to include a follow-up command on the same TCP command-line. Subsequent commands may be send to the PortaProg using a new command-line._
 --- */
-  {PARSER_CMD_UPLOAD, "UPLOAD", "<name> (stream)", "save any type of data stream to SPIFFS", 1, true, true},
+  {PARSER_CMD_UPLOAD, "UPLOAD", "<name> [offset|APPEND] (stream)", "save any type of data stream to SPIFFS", 1, 1, true, true},
+/* ---
+  - `UPLOADTXT` <filename> (stream): same as `UPLOAD` but the stream is treated as text;
+  carriage returns, null characters and leading white space are removed.
+--- */
+  {PARSER_CMD_UPLOADTXT, "UPLOADTXT", "<name> (stream)", "save a text stream to SPIFFS", 1, 0, true, true},
+  /* ---
+    - `DIR` [pattern [offset [count]]]: List the files currently stored on the SPIFFS in alphabetical order.
+    Without a pattern all files are listed except the hidden files, such as the `.<name>.sum` digests.
+    The pattern may use `*` and `?`; a pattern which starts with `.` lists hidden files, eg `DIR .*`.
+    The optional `offset` and `count` select a page of the matching files; the page is followed by a line
+    with the total number of matching files, so a client can poll a large directory a page at a time.
+  --- */
+  {PARSER_CMD_DIR, "DIR", "[pattern [offset [count]]]", "list files on SPIFFS", 0, 3, false, true},
+  /* ---
+    - `SIZE` <filename>: return the size of the file in bytes.
+  --- */
+  {PARSER_CMD_SIZE, "SIZE", "<name>", "return size of file", 1, 0, false, true},
+  /* ---
+    - `ZUPLOAD` <filename> [KEEP] (stream): same as `UPLOAD` but the stream is compressed (see lzstream.h).
+    The stream is decompressed while it is received and the file holds the original content.
+    With `KEEP` the file is stored compressed, exactly as received.
+  --- */
+  {PARSER_CMD_ZUPLOAD, "ZUPLOAD", "<name> [KEEP] (stream)", "save a compressed data stream to SPIFFS", 1, 1, true, true},
+  /* ---
+    - `ZCAT` <filename>: same as `CAT` but the content is compressed while it is sent.
+    A file which is stored compressed is sent as it is.
+  --- */
+  {PARSER_CMD_ZCAT, "ZCAT", "<name>", "stream compressed contents of file", 1, 0, false, true},
+  /* ---
+    - `HASH` <filename>: return the digest which was computed when the file was uploaded.
+    The file is not read, so this is instant. The digest has the form `CRC32=xxxxxxxx SIZE=n SHA256=xxxx...`.
+  --- */
+  {PARSER_CMD_HASH, "HASH", "<name>", "return stored digest of file", 1, 0, false, true},
+  /* ---
+    - `VERIFY` <filename>: read the file, compute its digest and compare it with the stored digest.
+  --- */
+  {PARSER_CMD_VERIFY, "VERIFY", "<name>", "check file against its stored digest", 1, 0, false, true},
+  /* ---
+    - `HEXINFO` <filename>: decode an Intel HEX file and report its address ranges and the total number of data bytes.
+  --- */
+  {PARSER_CMD_HEXINFO, "HEXINFO", "<name>", "report address ranges of HEX file", 1, 0, false, true},
+  /* ---
+    - `RUN` <filename>: execute the commands in a command file.
+    The file is parsed once and the parsed commands are kept, so running it again skips the parsing
+    until the file changes. The time spent parsing and executing is reported.
+    _NOTE: Commands with a stream (eg `UPLOAD`) can not be used in a command file._
+  --- */
+  {PARSER_CMD_RUN, "RUN", "<name>", "run command file", 1, 0, false, true},
   /* ---
-    - `DIR`: List all files currently stored on the SPIFFS.
+    - `SYNC`: write the data which is held in the write-back cache to the flash and report the cache counters.
   --- */
-  {PARSER_CMD_DIR, "DIR", "", "list files on SPIFFS", 0, false, true},
+  {PARSER_CMD_SYNC, "SYNC", "", "write cached data to flash", 0, 0, false, true},
 
 };
 
+#define PARSER_CMD_COUNT (sizeof(_parser_commands) / sizeof(parserCmd_t))
+
+// compile time sanity checks of the command table
+// (the checks split the table in halves so the constexpr recursion depth stays small for large tables)
+static constexpr bool _parserNameEquals(const char *a, const char *b)
+{
+  return ((*a == 0) || (*b == 0)) ? (*a == *b)
+         : ((((*a >= 'a') && (*a <= 'z')) ? (*a - 32) : *a) == (((*b >= 'a') && (*b <= 'z')) ? (*b - 32) : *b)) && _parserNameEquals(a + 1, b + 1);
+}
+
+static constexpr bool _parserCmdAbsent(size_t cmd, size_t lo, size_t hi)
+{
+  return (hi - lo == 0) ? true
+         : (hi - lo == 1) ? ((_parser_commands[cmd].id != _parser_commands[lo].id) && !_parserNameEquals(_parser_commands[cmd].name, _parser_commands[lo].name))
+         : (_parserCmdAbsent(cmd, lo, lo + (hi - lo) / 2) && _parserCmdAbsent(cmd, lo + (hi - lo) / 2, hi));
+}
+
+static constexpr bool _parserCmdsDisjoint(size_t lo1, size_t hi1, size_t lo2, size_t hi2)
+{
+  return (hi1 - lo1 == 0) ? true
+         : (hi1 - lo1 == 1) ? _parserCmdAbsent(lo1, lo2, hi2)
+         : (_parserCmdsDisjoint(lo1, lo1 + (hi1 - lo1) / 2, lo2, hi2) && _parserCmdsDisjoint(lo1 + (hi1 - lo1) / 2, hi1, lo2, hi2));
+}
+
+static constexpr bool _parserCmdsUnique(size_t lo, size_t hi)
+{
+  return (hi - lo <= 1) ? true
+         : (_parserCmdsUnique(lo, lo + (hi - lo) / 2) && _parserCmdsUnique(lo + (hi - lo) / 2, hi) && _parserCmdsDisjoint(lo, lo + (hi - lo) / 2, lo + (hi - lo) / 2, hi));
+}
+
+static_assert(_parser_commands[0].id == PARSER_CMD_HELP, "PARSER_CMD_HELP must be the first entry of _parser_commands[]");
+static_assert(_parserCmdsUnique(0, PARSER_CMD_COUNT), "_parser_commands[] has a duplicate command id or name");
+static_assert(PARSER_CMD_COUNT < 255, "_parser_hash_index[] stores command indexes as uint8_t");
+
+// command names are matched through an open addressed hash table which is built once from _parser_commands[]
+// a token is hashed case insensitive and normally needs a single strcasecmp() to confirm the match
+static constexpr uint16_t _parserHashSlots(uint16_t slots)
+{
+  // a power of 2 with at least twice the number of commands keeps the probe sequences short
+  return (slots >= (2 * PARSER_CMD_COUNT)) ? slots : _parserHashSlots(slots << 1);
+}
+
+#define PARSER_HASH_SLOTS _parserHashSlots(8)
+
+static uint8_t _parser_hash_index[PARSER_HASH_SLOTS]; // command index + 1; 0 marks an empty slot
+static bool _parser_hash_ready = false;
+
 const char *_parserHelp_text_usage = "Linux usage: (echo cmd; echo cmd; ...) | nc"; // the IP and port will be appended
 const char *_parserHelp_text_legend[] =
 {
@@ -157,6 +397,57 @@ static bool _parser_trim(char *line)
 } //  _parser_trim()
 
 
+//--------------------------------------------------------------------
+static uint32_t _parserHash(const char *name)
+{
+  // FNV-1a over the upper case characters
+  uint32_t hash = 2166136261UL;
+  while (*name)
+  {
+    hash ^= (uint8_t)toupper(*name++);
+    hash *= 16777619UL;
+  }
+  return hash;
+
+} //  _parserHash()
+
+
+//--------------------------------------------------------------------
+static void _parserBuildIndex()
+{
+  memset(_parser_hash_index, 0, sizeof(_parser_hash_index));
+  for (uint8_t i = 0; i < PARSER_CMD_COUNT; i++)
+  {
+    uint16_t slot = _parserHash(_parser_commands[i].name) & (PARSER_HASH_SLOTS - 1);
+    while (_parser_hash_index[slot])
+      slot = (slot + 1) & (PARSER_HASH_SLOTS - 1);
+    _parser_hash_index[slot] = i + 1;
+  }
+  _parser_hash_ready = true;
+
+} //  _parserBuildIndex()
+
+
+//--------------------------------------------------------------------
+static const parserCmd_t *_parserFindCommand(const char *name)
+{
+  if (!_parser_hash_ready)
+    _parserBuildIndex();
+
+  uint16_t slot = _parserHash(name) & (PARSER_HASH_SLOTS - 1);
+  //-- the table is never full so the probe always ends on an empty slot
+  while (_parser_hash_index[slot])
+  {
+    const parserCmd_t *cmd = &(_parser_commands[_parser_hash_index[slot] - 1]);
+    if (strcasecmp(cmd->name, name) == 0)
+      return cmd;
+    slot = (slot + 1) & (PARSER_HASH_SLOTS - 1);
+  }
+  return NULL;
+
+} //  _parserFindCommand()
+
+
 //--------------------------------------------------------------------
 static bool _is_printable(char *line)
 {
@@ -206,9 +497,7 @@ static bool _parserHelp(Stream *client)
   if (client)
   {
 
-    uint8_t entries = (sizeof(_parser_commands) / sizeof(parserCmd_t));
-
-    for (int i = 0; i < entries; i++)
+    for (uint8_t i = 0; i < PARSER_CMD_COUNT; i++)
     {
       // to save some scrolling, we do not pad the help text on the display
       //MESSAGE("%s %s %s\n", _parser_commands[i].name, _parser_commands[i].parms, _parser_commands[i].desc);
@@ -224,74 +513,379 @@ static bool _parserHelp(Stream *client)
     }
 
     // full formatted content back to client
-    ioStreamPrintf(client, "%s %s %d\n", _parserHelp_text_usage, WiFi.localIP().toString(), configWifiPort);
+    ioStreamPrintf(client, "%s %s %d\n", _parserHelp_text_usage, WiFi.localIP().toString().c_str(), configWifiPort);
   }
   return true;
   
 } //  _parserHelp()
 
 //--------------------------------------------------------------------
-// create a file with the contents of the stream *without* any interpretation other than excess whitespace
-static bool _parserSaveStream2File(Stream* client, char* filename) 
+// the rest of the session is a stream; it is discarded unless a destination is opened
+static void _parserStreamBegin(parserSession_t *session)
+{
+  session->streaming = true;
+  session->skip_line = (session->delimiter != '\n');
+  session->stream_mode = PARSER_STREAM_DISCARD;
+  session->data_size_processed = 0;
+  session->stream_start = millis();
+
+} //  _parserStreamBegin()
+
+
+//--------------------------------------------------------------------
+// create a file with the contents of the stream; the stream lasts until the session ends
+static bool _parserSaveStreamStart(parserSession_t *session, char *filename, uint8_t mode, uint32_t offset)
 {
   MESSAGE("Save stream to file %s\n", filename);
-  static char buffer[256+1];  // need space for null terminator
 
-  bool success = false;
-  int32_t len;
+  _parserStreamBegin(session);
+  session->stream_compressed = 0;
+  _parserProgramForget(filename);
+
+  if ((mode == PARSER_STREAM_LZ) && !lzDecoderBegin(&session->lz_decoder))
+  {
+    lzDecoderEnd(&session->lz_decoder);
+    ioStreamPrintf(session->client, "Error: not enough memory to decompress %s\n", filename);
+    return false;
+  }
 
-  File f = filesysOpen(filename, "w");
-  if (!f) {
-    ioStreamPrintf(client, "Error: unable to write to file %s\n", filename);
+  //-- when the file can not be opened the stream is discarded
+  if (!filesysSaveStartAt(filename, offset))
+  {
+    if (mode == PARSER_STREAM_LZ)
+      lzDecoderEnd(&session->lz_decoder);
+    if (offset)
+      ioStreamPrintf(session->client, "Error: unable to write to file %s at offset %u\n", filename, offset);
+    else
+      ioStreamPrintf(session->client, "Error: unable to write to file %s\n", filename);
+    return false;
   }
-  else
-    success = true;
+  if (!filesysCanDigest(filename))
+    ioStreamPrintf(session->client, "Error: the name %s is too long for a digest; the file is stored without one\n", filename);
+  session->stream_mode = mode;
+  return true;
 
-  do {
-    int c;
-    len = 0;
-    while (client->available()) {
-      c = client->read();
-      DEBUG("%c", c);
+} //  _parserSaveStreamStart()
 
-      if (c == '\r') continue;
-      if ((c == ' ') || (c == '\n')) 
-      {
-        //-- we throw away leading white space
-        if (!len) continue;
-      }
-      if (c == 0) break;
-      buffer[len++] = c;
 
-      //-- the result will not be pretty but we need to break before 
-      //-- overflow of the buffer
-      if (len == 256) break;  
+//--------------------------------------------------------------------
+// the file is closed and the rest of the stream is discarded
+static void _parserSaveStreamDrop(parserSession_t *session)
+{
+  filesysSaveFinish();
+  if (session->stream_mode == PARSER_STREAM_LZ)
+    lzDecoderEnd(&session->lz_decoder);
+  session->stream_mode = PARSER_STREAM_DISCARD;
+
+} //  _parserSaveStreamDrop()
+
+
+//--------------------------------------------------------------------
+static void _parserSaveStreamWrite(parserSession_t *session, uint8_t *data, size_t count)
+{
+  if (!count || (session->stream_mode == PARSER_STREAM_DISCARD))
+    return;
+
+  if (!filesysSaveWrite(data, count))
+  {
+    ioStreamPrintf(session->client, "Error: write failed after %u bytes\n", session->data_size_processed);
+    _parserSaveStreamDrop(session);
+    return;
+  }
+  session->data_size_processed += count;
+
+} //  _parserSaveStreamWrite()
+
+
+//--------------------------------------------------------------------
+// store a chunk of the stream; the chunk may be modified
+static void _parserSaveStreamData(parserSession_t *session, uint8_t *data, size_t count)
+{
+  if (session->skip_line)
+  {
+    //-- the stream starts on the line after the command
+    uint8_t *eol = (uint8_t *)memchr(data, '\n', count);
+    if (!eol)
+      return;
+    session->skip_line = false;
+    count -= (eol + 1 - data);
+    data = eol + 1;
+  }
+
+  if (session->stream_mode == PARSER_STREAM_TEXT)
+  {
+    //-- *without* any interpretation other than excess whitespace; the chunk is filtered in place
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      uint8_t c = data[i];
+      if ((c == '\r') || (c == 0))
+        continue;
+      //-- we throw away leading white space
+      if (!session->data_size_processed && !len && ((c == ' ') || (c == '\n')))
+        continue;
+      data[len++] = c;
     }
+    count = len;
+  }
 
-    if (len > 0) 
+  if (session->stream_mode == PARSER_STREAM_LZ)
+  {
+    //-- the stream is decompressed in blocks; the size reported is the size of the file
+    session->stream_compressed += count;
+    uint8_t *block = _parser_lz_block;
+    while (count && (session->stream_mode == PARSER_STREAM_LZ))
     {
-      //buffer[len++] = '\n'; // newline (I don't think so!)
-      buffer[len++] = 0;    // null terminate the string
+      size_t taken = count;
+      size_t len = lzDecode(&session->lz_decoder, data, &taken, block, PARSER_LZ_BLOCK);
+      data += taken;
+      count -= taken;
+      if (session->lz_decoder.error)
+      {
+        ioStreamPrintf(session->client, "Error: invalid compressed stream after %u bytes\n", session->data_size_processed);
+        _parserSaveStreamDrop(session);
+        return;
+      }
+      _parserSaveStreamWrite(session, block, len);
+    }
+    return;
+  }
+
+  _parserSaveStreamWrite(session, data, count);
+
+} //  _parserSaveStreamData()
+
+
+//--------------------------------------------------------------------
+static void _parserSaveStreamFinish(parserSession_t *session)
+{
+  if (session->stream_mode == PARSER_STREAM_DISCARD)
+    return;
+
+  bool complete = true;
+  if (session->stream_mode == PARSER_STREAM_LZ)
+    complete = lzDecoderEnd(&session->lz_decoder);
+  uint8_t mode = session->stream_mode;
+  session->stream_mode = PARSER_STREAM_DISCARD;
+  if (!filesysSaveFinish())
+  {
+    ioStreamPrintf(session->client, "Error: write failed after %u bytes\n", session->data_size_processed);
+    return;
+  }
+  if (!complete)
+    ioStreamPrintf(session->client, "Error: the compressed stream ended early\n");
+
+  uint32_t elapsed = millis() - session->stream_start;
+  ioStreamPrintf(session->client, "Received %u bytes in %u ms (%.3f MB/s)\n", session->data_size_processed, elapsed,
+                 elapsed ? (session->data_size_processed / 1024.0 / 1024.0) / (elapsed / 1000.0) : 0.0);
+  if (mode == PARSER_STREAM_LZ)
+    ioStreamPrintf(session->client, "Decompressed from %u bytes\n", session->stream_compressed);
+  DEBUG("Received %d bytes\n", session->data_size_processed);
+
+} //  _parserSaveStreamFinish()
+
+
+//--------------------------------------------------------------------
+// send the raw content of a file; the content is sent by the following polls
+// a length of 0 sends everything from the offset to the end of the file
+static bool _parserSendFileStart(parserSession_t *session, char *filename, uint32_t offset, uint32_t length)
+{
+  DEBUG("send file to stream %s\n", filename);
+
+  session->send_file = filesysOpen(filename, "r");
+  if (!session->send_file)
+  {
+    ioStreamPrintf(session->client, "Error: unable to open %s\n", filename);
+    return false;
+  }
+
+  uint32_t size = session->send_file.size();
+  if ((offset > size) || !session->send_file.seek(offset))
+  {
+    ioStreamPrintf(session->client, "Error: offset %u is beyond the end of %s\n", offset, filename);
+    filesysClose(session->send_file);
+    session->send_file = File();
+    return false;
+  }
+
+  session->send_remaining = size - offset;
+  if (length && (length < session->send_remaining))
+    session->send_remaining = length;
+  session->sending = true;
+  return true;
+
+} //  _parserSendFileStart()
+
+
+//--------------------------------------------------------------------
+// a command starts a response; the counters of the cork mark where it starts
+static void _parserResponseBegin(parserSession_t *session)
+{
+  corkStream *cork = corkStream::of(session->client);
+  session->responding = true;
+  session->response_start = cork ? cork->count() : 0;
+  session->response_errors = cork ? cork->errorCount() : 0;
+
+} //  _parserResponseBegin()
+
+
+//--------------------------------------------------------------------
+// the command and its output are complete; a keep alive session sends the status line
+static void _parserResponseEnd(parserSession_t *session)
+{
+  if (!session->responding || session->sending || session->streaming)
+    return;
+  session->responding = false;
+  corkStream *cork = corkStream::of(session->client);
+  if (!session->keep_alive || !cork)
+    return;
+  ioStreamPrintf(session->client, "=%s %u\n", (cork->errorCount() != session->response_errors) ? "ERR" : "OK",
+                 cork->count() - session->response_start);
+
+} //  _parserResponseEnd()
+
+
+//--------------------------------------------------------------------
+static void _parserSendFileFinish(parserSession_t *session)
+{
+  if (session->sending)
+  {
+    filesysClose(session->send_file);
+    session->send_file = File();
+    session->sending = false;
+  }
+  if (session->send_lz)
+  {
+    lzEncoderEnd(&session->lz_encoder);
+    free(session->send_buf);
+    session->send_buf = NULL;
+    session->send_lz = false;
+  }
+  _parserResponseEnd(session);
+
+} //  _parserSendFileFinish()
+
+
+//--------------------------------------------------------------------
+// send the content of a file compressed; a file which is stored compressed is sent as it is
+static bool _parserSendLzStart(parserSession_t *session, char *filename)
+{
+  if (!_parserSendFileStart(session, filename, 0, 0))
+    return false;
+
+  uint8_t magic[4];
+  size_t len = session->send_file.read(magic, sizeof(magic));
+  session->send_file.seek(0);
+  if (lzIsCompressed(magic, len))
+    return true;
+
+  session->send_buf = (uint8_t *)malloc(PARSER_SEND_CHUNK);
+  if (!session->send_buf || !lzEncoderBegin(&session->lz_encoder))
+  {
+    free(session->send_buf);
+    session->send_buf = NULL;
+    _parserSendFileFinish(session);
+    ioStreamPrintf(session->client, "Error: not enough memory to compress %s\n", filename);
+    return false;
+  }
+  session->send_lz = true;
+  session->send_fill = 0;
+  session->send_done = 0;
+  return true;
+
+} //  _parserSendLzStart()
+
+
+//--------------------------------------------------------------------
+// the compressed content is produced in send_buf and held there until the client has taken it
+static void _parserSendLzData(parserSession_t *session, bool wait)
+{
+  Stream *client = session->client;
+  uint8_t *input = _parser_lz_block;
 
-      // write the buffer to the file
-      if (f) 
+  for (int burst = 0; session->sending && (wait || (burst < PARSER_SEND_BURST)); burst++)
+  {
+    if (session->send_done == session->send_fill)
+    {
+      //-- compress the next part of the file; what the encoder does not take is read again
+      size_t len = session->send_file.read(input, PARSER_LZ_BLOCK);
+      bool finish = !session->send_file.available();
+      size_t taken = len;
+      session->send_fill = lzEncode(&session->lz_encoder, input, &taken, session->send_buf, PARSER_SEND_CHUNK, finish);
+      session->send_done = 0;
+      if (taken < len)
+        session->send_file.seek(session->send_file.position() - (len - taken));
+      if (!session->send_fill)
       {
-        //-- the line buffer contains STREAM data to append to the active file
-        f.print(buffer);
-        VERBOSE("write: %s", buffer);
+        if (finish)
+          _parserSendFileFinish(session);
+        continue;
       }
     }
-    else 
+
+    size_t len = session->send_fill - session->send_done;
+    int room = client->availableForWrite();
+    if ((room > 0) && ((size_t)room < len))
+      len = room;
+    size_t sent = client->write(session->send_buf + session->send_done, len);
+    if (!sent)
     {
-      VERBOSE("OOPS: we should not have an empty line\n");
+      //-- the client has gone
+      _parserSendFileFinish(session);
+      return;
     }
+    session->send_done += sent;
   }
-  while (len > 0);
 
-  filesysClose(f);
-  return success;
-  
-} //  _parserSaveStream2File()
+} //  _parserSendLzData()
+
+
+//--------------------------------------------------------------------
+// move file content to the client in MSS sized chunks without formatting
+// unless told to wait, it stops after PARSER_SEND_BURST chunks
+static void _parserSendFileData(parserSession_t *session, bool wait)
+{
+  Stream *client = session->client;
+  uint8_t *chunk = _parser_send_chunk;
+
+  if (session->send_lz)
+  {
+    _parserSendLzData(session, wait);
+    return;
+  }
+
+  for (int burst = 0; session->sending && (wait || (burst < PARSER_SEND_BURST)); burst++)
+  {
+    size_t len = PARSER_SEND_CHUNK;
+    //-- we never give the client more than it has room for;
+    //-- a client which does not report its room (0) gets full chunks and its write() waits
+    int room = client->availableForWrite();
+    if ((room > 0) && ((size_t)room < len))
+      len = room;
+    if (len > session->send_remaining)
+      len = session->send_remaining;
+
+    if (len)
+      len = session->send_file.read(chunk, len);
+    if (!len)
+    {
+      _parserSendFileFinish(session);
+      return;
+    }
+
+    size_t sent = client->write(chunk, len);
+    if (!sent)
+    {
+      //-- the client has gone
+      _parserSendFileFinish(session);
+      return;
+    }
+    if (sent < len)
+      session->send_file.seek(session->send_file.position() - (len - sent));
+    session->send_remaining -= sent;
+  }
+
+} //  _parserSendFileData()
 
 
 //--------------------------------------------------------------------
@@ -322,6 +916,65 @@ static bool _parserReadFile2Stream(Stream* client, char* filename) {
 
 } //  _parserStreamFile2Spiffs()
 
+//--------------------------------------------------------------------
+// HEXINFO merges the blocks of the decoder into address ranges
+typedef struct
+{
+  Stream *client;
+  uint32_t start;
+  uint32_t end;
+  uint16_t ranges;
+} _parserHexRanges;
+
+static void _parserHexRangePrint(_parserHexRanges *ranges)
+{
+  if (ranges->ranges)
+    ioStreamPrintf(ranges->client, "0x%08X - 0x%08X  %u bytes\n", ranges->start, ranges->end - 1, ranges->end - ranges->start);
+
+} //  _parserHexRangePrint()
+
+
+static bool _parserHexRangeSink(void *ctx, uint32_t address, const uint8_t *data, size_t len)
+{
+  _parserHexRanges *ranges = (_parserHexRanges *)ctx;
+  if (ranges->ranges && (address == ranges->end))
+  {
+    ranges->end += len;
+    return true;
+  }
+  _parserHexRangePrint(ranges);
+  ranges->start = address;
+  ranges->end = address + len;
+  ranges->ranges++;
+  return true;
+
+} //  _parserHexRangeSink()
+
+
+//--------------------------------------------------------------------
+static void _parserHexInfo(Stream *client, char *filename)
+{
+  static hexDecoder_t hex; // too large for the stack
+  _parserHexRanges ranges = {client, 0, 0, 0};
+
+  File input = filesysOpen(filename, "r");
+  if (!input)
+  {
+    ioStreamPrintf(client, "Error: unable to open %s\n", filename);
+    return;
+  }
+
+  hexBegin(&hex, _parserHexRangeSink, &ranges);
+  uint8_t error = filesysReadHex(&input, &hex);
+  filesysClose(input);
+
+  _parserHexRangePrint(&ranges);
+  if (error)
+    ioStreamPrintf(client, "Error: %s in record %u of %s\n", hexErrorText(error), hex.records, filename);
+  ioStreamPrintf(client, "%u bytes in %u ranges, start address 0x%08X\n", hex.bytes, ranges.ranges, hex.start);
+
+} //  _parserHexInfo()
+
 /* --
 #### parserInit()
 
@@ -335,9 +988,10 @@ bool parserInit()
 {
 
   g_last_received_string[0] = 0;
+  _parserBuildIndex();
 
 
-  MESSAGE("Usage:\necho 'help' | nc %s %d\n", WiFi.localIP().toString(), TCP_PORT);
+  MESSAGE("Usage:\necho 'help' | nc %s %d\n", WiFi.localIP().toString().c_str(), TCP_PORT);
 
   /*
     if (configWifiSSID[0] == 0) {
@@ -364,261 +1018,986 @@ void parserLoop()
   _uartLoop(true, NULL); // this lets the PortaProg receive and display UART messages; it is RX-only
 }
 
-/* --
-#### parserProcessCommands()
+//--------------------------------------------------------------------
+// take up to 'limit' bytes from the client with a single call; they become the input of the session
+static size_t _parserReadInput(parserSession_t *session, size_t limit)
+{
+  Stream *client = session->client;
+  int count = client->available();
+  if (count <= 0)
+    return 0;
+  if (!session->input)
+  {
+    session->input = (uint8_t *)malloc(PARSER_CHUNK_SIZE);
+    if (!session->input)
+    {
+      //-- the input stays with the client until there is memory
+      DEBUG("no memory for the parser input\n");
+      return 0;
+    }
+  }
+  //-- never ask for more than is available; readBytes() would wait for the rest
+  if ((size_t)count > limit)
+    count = limit;
+  session->input_pos = 0;
+  session->input_len = client->readBytes(session->input, count);
+  return session->input_len;
 
-Process a Stream of commands. The most common Stream source is the TCP data. Any Stream is
-supported provided it implements read(), write(), and all print...() methods.
+} //  _parserReadInput()
 
-- input: client **Stream ptr** an active Stream with the commands and data to be processes
-- input: aborted **bool** indicates a prior command aborted
--- */
 
-bool parserProcessCommands(Stream *client, bool aborted)
+//--------------------------------------------------------------------
+static size_t _parserChunkLimit(parserSession_t *session)
 {
+  //-- while a stream is stored we take no more than the file system accepts without waiting;
+  //-- the rest stays with the client so TCP pushes back on the sender
+  if (session->streaming && (session->stream_mode != PARSER_STREAM_DISCARD))
+  {
+    size_t room = filesysSaveWritable();
+    //-- compressed data grows when it is decompressed; a single byte may always be taken
+    if ((session->stream_mode == PARSER_STREAM_LZ) && room)
+      room = (room > LZ_MAX_EXPANSION) ? (room / LZ_MAX_EXPANSION) : 1;
+    return (room < PARSER_CHUNK_SIZE) ? room : PARSER_CHUNK_SIZE;
+  }
+  return PARSER_CHUNK_SIZE;
 
-  if (!client)
+} //  _parserChunkLimit()
+
+
+//--------------------------------------------------------------------
+// split the args in the linebuffer in place; returns the number of args
+static uint8_t _parserSplitArgs(char *linebuffer, char **argv, uint8_t max)
+{
+  uint8_t argc = 0;
+  char *arg = linebuffer;
+
+  while (*arg && (argc < max))
   {
-    // oops - we cant work without a connected client
-    MESSAGE("PARSER processing client not available");
-    return false;
+    argv[argc++] = arg;
+    arg = strchr(arg, ' ');
+    if (!arg)
+      break;
+    *arg++ = 0;
   }
-  DEBUGSERIAL.println("parserProcessCommands()...");
-
-  // Get data from the client and process it
-  uint32_t total = 0; // for diagnostics // TODO remove once things are working
-  uint16_t len = 0;
-  char c = 0;
-  char *linebuffer = g_network_buf;
-  int8_t command_id = PARSER_CMD_NONE;
-  parserCmd_t *active_cmd = NULL;
-  uint8_t command_index = 0;
-  bool expecting_args, active_file;
-  bool abort_processing = aborted;
-  int8_t args = 0;
-  uint32_t data_size_processed = 0;
+  return argc;
 
-  do
+} //  _parserSplitArgs()
+
+
+//--------------------------------------------------------------------
+static bool _parserNumber(const char *text, uint32_t *value)
+{
+  char *end;
+  *value = strtoul(text, &end, 0);
+  return ((end != text) && (*end == 0));
+
+} //  _parserNumber()
+
+
+//--------------------------------------------------------------------
+// DIR [pattern [offset [count]]]; every line is formatted on the stack and written to the client
+static void _parserDir(Stream *client, char *linebuffer)
+{
+  char *argv[3] = {NULL, NULL, NULL};
+  uint8_t argc = _parserSplitArgs(linebuffer, argv, 3);
+  uint32_t offset = 0, count = UINT32_MAX;
+  if (((argc > 1) && !_parserNumber(argv[1], &offset)) || ((argc > 2) && !_parserNumber(argv[2], &count)))
   {
-    if (command_id == PARSER_CMD_NONE)
+    ioStreamPrintf(client, "Error: DIR offset and count are numbers\n");
+    return;
+  }
+
+  filesysDir_t dir;
+  filesysEntry_t entry;
+  char line[MAX_FILENAME_LEN + MAX_FORMATBYTES + 4];
+  uint32_t matched = 0, listed = 0;
+
+  //-- hidden files, like the digest sidecars, are listed by a pattern which starts with '.'
+  client->print("Contents:\n");
+  filesysDirBegin(&dir, argc ? argv[0] : NULL, false);
+  while (filesysDirNext(&dir, &entry))
+  {
+    //-- the files after the page are only counted
+    if ((matched++ >= offset) && (listed < count))
     {
-      DEBUGSERIAL.println("zoek command_id...");
-      expecting_args = false;
-      active_file = false;
-      args = 0;
-      len = 0;
-      command_index = 0;
-      active_cmd = NULL;
+      line[0] = '\t';
+      int len = 1 + filesysFormatEntry(&entry, line + 1, sizeof(line) - 2);
+      line[len++] = '\n';
+      client->write((uint8_t *)line, len);
+      listed++;
     }
+  }
+  filesysDirEnd(&dir);
+  if (argc > 1)
+    client->printf("%u of %u files from %u\n", listed, matched, offset);
+  client->print("\n");
 
-    //-- with the exception of a stream, commands do not split across lines. 
-    //-- commands with streams will start the stream on a new line.
-    while (client->available())
-    {
-      //-- we process commands and arguments the same - both assume 
-      //-- whitespace as a delimeter
-      //VERBOSE("?");
-      c = client->read();
-      total++;
-      //VERBOSE("%c", c);
+} //  _parserDir()
 
-      if (c == 0)
-        break;
-      if (c == '\r')
-        continue;
-      if ((c == ' ') || (c == '\n'))
-      {
-        if (!len) // we can throw away leading white space
-          continue;
-        break;
-      }
 
-      linebuffer[len++] = c;
-      // we chunk large streams of data
-      if (len >= MAX_NETWORK_TEXT)
-        break;
-    }
+//--------------------------------------------------------------------
+// forget the active command so the next token is matched against the command table
+static void _parserSessionReset(parserSession_t *session)
+{
+  session->command_id = PARSER_CMD_NONE;
+  session->active_cmd = NULL;
+  session->expecting_args = false;
+  session->args = 0;
+  session->len = 0;
+  session->token_start = 0;
 
-    DEBUGSERIAL.printf("parsed [%s]\r\n", linebuffer);
+} //  _parserSessionReset()
 
-    if (len)
-    {
-      linebuffer[len++] = 0;
-      //len = 0; //-- this will force the outer loop to start reading 
-                 //-- a new command or parameter
-      //VERBOSE("parsed string: %s\n", linebuffer);
 
-      // if we do not have an active command, then we look for one
-      if (command_id < 0)
+//--------------------------------------------------------------------
+// run the active command; any required args - with the exception of a stream - are
+// contiguous in the linebuffer and can be parsed by the command
+static void _parserExecute(parserSession_t *session)
+{
+  Stream *client = session->client;
+  char *linebuffer = session->linebuffer;
+
+  switch (session->command_id)
+  {
+    case PARSER_CMD_NONE:
+    {
+    } break;
+    // informational operations
+    case PARSER_CMD_HELP:
+    {
+      _parserHelp(client);
+    }
+    break;
+    case PARSER_CMD_INFO:
+    {
+      //DEBUGSERIAL.printf("get_info(%s);\r\n", linebuffer);
+      char arg1[11];
+      char arg2[11];
+      int noArgs = sscanf(linebuffer, "%10s %10s", arg1, arg2);
+      if (noArgs == 2) 
       {
-        // no active command so we look for a match
-        for (command_index = 0; command_index < (sizeof(_parser_commands) / sizeof(parserCmd_t)); command_index++)
-        {
-          // if we match a command from our list, make a note of it
-          if (strcasecmp(_parser_commands[command_index].name, linebuffer) == 0)
-          {
-            active_cmd = &(_parser_commands[command_index]);
-            command_id = _parser_commands[command_index].id;
-            for(int i=0; i<strlen(active_cmd->name); i++) linebuffer[i]=' ';
-            //DEBUGSERIAL.printf("ActiveCmd#[%d], linebuffer[%s]\r\n", command_id, linebuffer);
-            break;
-          }
-        }
+        DEBUG("INFO: p1=[%s], p2=[%s]\n", arg1, arg2);
+        ioStreamPrintf(client, "INFO: p1=[%s], p2=[%s]\r\n", arg1, arg2);
+      } 
+      else 
+      {
+        ioStreamPrintf(client, "Error: unrecognized INFO parameters: [%s]\r\n", linebuffer);
+        ioStreamPrintf(client, "       INFO needs 2 parameters, found [%d]\r\n", noArgs);
+        ioStreamPrintf(client, "       INFO parameter uses a strict format: <num> <num>\n");
+      }
+    }
+    break;
+    case PARSER_CMD_LOG:
+    {
+      char *end;
+      unsigned long level = strtoul(linebuffer, &end, 10);
+      if (!linebuffer[0])
+        level = LOG_LEVEL_VERBOSE;
+      else if (*end)
+      {
+        ioStreamPrintf(client, "Error: LOG level is a number\n");
+        break;
       }
-      // if we still don't have a command, then its an error
-      if (!active_cmd)
+      uint16_t count = logDump(client, level);
+      ioStreamPrintf(client, "%u log records\n", count);
+    }
+    break;
+    case PARSER_CMD_KEEPALIVE:
+    {
+      if (linebuffer[0] && strcasecmp(linebuffer, "OFF"))
       {
-        ioStreamPrintf(client, "Error, unrecognized command: [%s]\n\n", linebuffer);
-        client->flush();
-        command_id = PARSER_CMD_NONE; // output the help text
+        ioStreamPrintf(client, "Error: KEEPALIVE option is OFF\n");
+        break;
       }
+      bool on = !linebuffer[0];
+      ioStreamPrintf(client, "Keep alive %s\n", on ? "on" : "off");
+      if (!on)
+        _parserResponseEnd(session); //-- the last status line
+      session->keep_alive = on;
+    }
+    break;
+    // generic file operations
+    case PARSER_CMD_DIR: 
+    {
+      _parserDir(client, linebuffer);
+    } break;
+    case PARSER_CMD_DEL: {
+      // linebuffer now has the first arg = the filename
+      if (!filesysExists(linebuffer))
+        ioStreamPrintf(client, "Error: file %s does not exist\n", linebuffer);
+      else {
+        filesysDelete(linebuffer);
+        _parserProgramForget(linebuffer);
+        ioStreamPrintf(client, "File %s deleted\n", linebuffer);
+        //-aaw- ioClear(true);
+      }
+    } break;
+    case PARSER_CMD_CAT: {
+      // CAT <name> [offset [length]]
+      char *argv[3] = {NULL, NULL, NULL};
+      uint8_t argc = _parserSplitArgs(linebuffer, argv, 3);
+      uint32_t offset = 0, length = 0;
+      if (((argc > 1) && !_parserNumber(argv[1], &offset)) || ((argc > 2) && !_parserNumber(argv[2], &length)))
+        ioStreamPrintf(client, "Error: CAT offset and length are numbers\n");
+      else
+        _parserSendFileStart(session, argv[0], offset, length);
+    } break;
+    case PARSER_CMD_SIZE: {
+      int32_t size = filesysGetSize(linebuffer);
+      if (size < 0)
+        ioStreamPrintf(client, "Error: file %s does not exist\n", linebuffer);
+      else
+        ioStreamPrintf(client, "%d\n", size);
+    } break;
+    case PARSER_CMD_HASH: {
+      char stored[DIGEST_TEXT_LEN];
+      if (!filesysExists(linebuffer))
+        ioStreamPrintf(client, "Error: file %s does not exist\n", linebuffer);
+      else if (!filesysCanDigest(linebuffer))
+        ioStreamPrintf(client, "Error: the name %s is too long for a digest\n", linebuffer);
+      else if (!filesysGetDigest(linebuffer, stored, sizeof(stored)))
+        ioStreamPrintf(client, "Error: no digest stored for %s\n", linebuffer);
+      else
+        ioStreamPrintf(client, "%s\n", stored);
+    } break;
+    case PARSER_CMD_VERIFY: {
+      char stored[DIGEST_TEXT_LEN];
+      char computed[DIGEST_TEXT_LEN];
+      if (!filesysComputeDigest(linebuffer, computed, sizeof(computed)))
+        ioStreamPrintf(client, "Error: unable to open %s\n", linebuffer);
+      else if (!filesysCanDigest(linebuffer))
+        ioStreamPrintf(client, "Error: the name %s is too long for a digest; computed %s\n", linebuffer, computed);
+      else if (!filesysGetDigest(linebuffer, stored, sizeof(stored)))
+        ioStreamPrintf(client, "Error: no digest stored for %s; computed %s\n", linebuffer, computed);
+      else if (strcmp(stored, computed) != 0)
+        ioStreamPrintf(client, "Error: %s does not match\nstored   %s\ncomputed %s\n", linebuffer, stored, computed);
       else
+        ioStreamPrintf(client, "OK %s\n", computed);
+    } break;
+    case PARSER_CMD_HEXINFO: {
+      _parserHexInfo(client, linebuffer);
+    } break;
+    case PARSER_CMD_SYNC: {
+      char stats[160];
+      filesysSync();
+      filesysCacheStats(stats, sizeof(stats));
+      ioStreamPrintf(client, "Cache: %s\n", stats);
+    } break;
+    case PARSER_CMD_CATTXT: {
+      _parserReadFile2Stream(client, linebuffer);
+    } break;
+    case PARSER_CMD_UPLOAD: {
+      // UPLOAD <name> [offset|APPEND]
+      char *argv[2] = {NULL, NULL};
+      uint8_t argc = _parserSplitArgs(linebuffer, argv, 2);
+      uint32_t offset = 0;
+      if ((argc > 1) && (strcasecmp(argv[1], "APPEND") == 0))
       {
-        //-- if we received a command which needs args we can just continue 
-        //-- the processing loop for the first arg
-        //-- NOTE: the command is responsible for subsequent args
-        if ((active_cmd->id > PARSER_CMD_HELP) && (active_cmd->args > args))
-        {
-          //-- TODO clean up this code so it isn't checking the arg count three times !
-          if (!expecting_args)
-          {
-            expecting_args = true;
-            len = 0;
-          }
-          else
-          {
-            args++; //-- we have an arg
-            if (active_cmd->args > args)
-            {
-              //-- we still meed more args so ...
-              len--;           //-- we remove the null terminator
-              linebuffer[len++] = ' '; //-- and replace it with a space
-            }
-          }
-          //DEBUGSERIAL.printf("%s need %d arg(s) has %d = %s\r\n", active_cmd->name, active_cmd->args, args, linebuffer);
-          if (active_cmd->args > args)
-            continue;
-        }
-
-        DEBUGSERIAL.printf("checking command: #%d %s\n", command_id, linebuffer);
-
-        //-- process the designated command
-        //-- any required args - with the expection of a stream - are contiguous 
-        //-- in the linebuffer buffer and can be parsed by the command
-        if (abort_processing)
-        {
-          if (active_cmd->abortable)
-          {
-            DEBUGSERIAL.printf("Aborting CMD: %s %s\n", active_cmd->name, linebuffer);
-            //-- skip everything else if this command has a stream as its last parameter
-            if (active_cmd->has_stream)
-            {
-              while (client->available())
-                c = client->read();
-            }
-            command_id = PARSER_CMD_NONE;
-          }
-          else
-          {
-            DEBUGSERIAL.printf("Non-Abortable CMD: %s %s\n", active_cmd->name, linebuffer);
-          }
-        }
+        int32_t size = filesysGetSize(argv[0]);
+        offset = (size > 0) ? size : 0;
       }
-
-      switch (command_id)
+      else if ((argc > 1) && !_parserNumber(argv[1], &offset))
       {
-        case PARSER_CMD_NONE:
-        {
-        } break;
-        // informational operations
-        case PARSER_CMD_HELP:
-        {
-          _parserHelp(client);
-          command_id = PARSER_CMD_NONE;
-        }
+        ioStreamPrintf(client, "Error: UPLOAD offset is a number or APPEND\n");
+        _parserStreamBegin(session);
         break;
-        case PARSER_CMD_INFO:
-        {
-          //DEBUGSERIAL.printf("get_info(%s);\r\n", linebuffer);
-          char arg1[11];
-          char arg2[11];
-          int noArgs = sscanf(linebuffer, "%10s %10s", arg1, arg2);
-          if (noArgs == 2) 
-          {
-            DEBUGSERIAL.printf("INFO: p1=[%s], p2=[%s]\r\n", arg1, arg2);
-            ioStreamPrintf(client, "INFO: p1=[%s], p2=[%s]\r\n", arg1, arg2);
-          } 
-          else 
-          {
-            ioStreamPrintf(client, "Error: unrecognized INFO parameters: [%s]\r\n", linebuffer);
-            ioStreamPrintf(client, "       INFO needs 2 parameters, found [%d]\r\n", noArgs);
-            ioStreamPrintf(client, "       INFO parameter uses a strict format: <num> <num>\n");
-          }
-          command_id = PARSER_CMD_NONE;
-        }
+      }
+      _parserSaveStreamStart(session, argv[0], PARSER_STREAM_RAW, offset);
+    } break;
+    case PARSER_CMD_ZUPLOAD: {
+      // ZUPLOAD <name> [KEEP]
+      char *argv[2] = {NULL, NULL};
+      uint8_t argc = _parserSplitArgs(linebuffer, argv, 2);
+      if ((argc > 1) && (strcasecmp(argv[1], "KEEP") != 0))
+      {
+        ioStreamPrintf(client, "Error: ZUPLOAD option is KEEP\n");
+        _parserStreamBegin(session);
         break;
-        // generic file operations
-        case PARSER_CMD_DIR: 
-        {
-          ioStreamPrintf(client, "Contents:\n");
-          char *info = filesysGetFileInfo(true, true);
-          while (info) {
-            ioStreamPrintf(client, "\t%s\n", info);
-            info = filesysGetFileInfo(false, true);
-          }
-          client->print("\n");
-          command_id = PARSER_CMD_NONE;
-        } break;
-        case PARSER_CMD_DEL: {
-          // linebuffer now has the first arg = the filename
-          if (!filesysExists(linebuffer))
-            ioStreamPrintf(client, "Error: file %s does not exist\n", linebuffer);
-          else {
-            filesysDelete(linebuffer);
-            ioStreamPrintf(client, "File %s deleted\n", linebuffer);
-            //-aaw- ioClear(true);
-          }
-          command_id = PARSER_CMD_NONE;
-        } break;
-        case PARSER_CMD_CAT: {
-          _parserReadFile2Stream(client, linebuffer);
-          command_id = PARSER_CMD_NONE;
-        } break;
-        case PARSER_CMD_UPLOAD: {
-          _parserSaveStream2File(client, linebuffer);
-          command_id = PARSER_CMD_NONE;
-        } break;
-
-      } // end command switch
-
-#if 0
-      // if one of our commands signals we need to abort, then run out any remaining command stream data
-      if (abort_processing)
+      }
+      _parserSaveStreamStart(session, argv[0], (argc > 1) ? PARSER_STREAM_RAW : PARSER_STREAM_LZ, 0);
+    } break;
+    case PARSER_CMD_ZCAT: {
+      _parserSendLzStart(session, linebuffer);
+    } break;
+    case PARSER_CMD_UPLOADTXT: {
+      _parserSaveStreamStart(session, linebuffer, PARSER_STREAM_TEXT, 0);
+    } break;
+
+  } // end command switch
+
+  _parserSessionReset(session);
+  _parserResponseEnd(session);
+
+} //  _parserExecute()
+
+
+static void _parserRun(parserSession_t *session);
+static void _parserProgramAdd(parserSession_t *session);
+
+//--------------------------------------------------------------------
+// the active command has its required args and may take more
+static bool _parserArgsOptional(parserSession_t *session)
+{
+  const parserCmd_t *active_cmd = session->active_cmd;
+  return (session->expecting_args && active_cmd && (session->args >= active_cmd->args) && (session->args < (active_cmd->args + active_cmd->opt_args)));
+
+} //  _parserArgsOptional()
+
+
+//--------------------------------------------------------------------
+// no more args will come; the separator after the last one is dropped
+static void _parserArgsComplete(parserSession_t *session)
+{
+  session->linebuffer[session->len ? (session->len - 1) : 0] = 0;
+  _parserRun(session);
+
+} //  _parserArgsComplete()
+
+
+//--------------------------------------------------------------------
+// a complete token is in the linebuffer; it is either a command or an arg of the active command
+static void _parserToken(parserSession_t *session)
+{
+  Stream *client = session->client;
+  char *linebuffer = session->linebuffer;
+  uint16_t len = session->len;
+
+  linebuffer[len++] = 0;
+  //VERBOSE("parsed string: %s\n", linebuffer);
+  DEBUG("parsed [%s]\n", linebuffer);
+
+  // if we do not have an active command, then we look for one
+  if (session->command_id < 0)
+  {
+    _parserResponseBegin(session);
+    session->active_cmd = _parserFindCommand(linebuffer);
+    if (session->active_cmd)
+    {
+      // we matched a command from our list, make a note of it
+      session->command_id = session->active_cmd->id;
+      for(int i=0; i<strlen(session->active_cmd->name); i++) linebuffer[i]=' ';
+      //DEBUGSERIAL.printf("ActiveCmd#[%d], linebuffer[%s]\r\n", session->command_id, linebuffer);
+    }
+  }
+
+  const parserCmd_t *active_cmd = session->active_cmd;
+
+  // if we still don't have a command, then its an error
+  if (!active_cmd)
+  {
+    if (session->program)
+      session->program->failed = true;
+    ioStreamPrintf(client, "Error, unrecognized command: [%s]\n\n", linebuffer);
+    client->flush();
+    _parserSessionReset(session);
+    _parserResponseEnd(session);
+    return;
+  }
+
+  //-- if we received a command which takes args we wait for the next token
+  //-- the args are collected in the linebuffer separated by a single space
+  //-- optional args are only taken from the same line as the command and end at a command name
+  if ((active_cmd->id > PARSER_CMD_HELP) && ((active_cmd->args + active_cmd->opt_args) > 0))
+  {
+    if (!session->expecting_args)
+    {
+      session->expecting_args = true;
+      len = 0;
+    }
+    else if (_parserArgsOptional(session) && _parserFindCommand(linebuffer + session->token_start))
+    {
+      //-- run the active command without the token; the token then starts the next command
+      char name[MAX_FILENAME_LEN + 1];
+      snprintf(name, sizeof(name), "%s", linebuffer + session->token_start);
+      session->len = session->token_start;
+      _parserArgsComplete(session);
+      if (session->streaming || session->skip_line)
+        return;
+      _parserSessionReset(session);
+      session->len = snprintf(linebuffer, MAX_NETWORK_TEXT, "%s", name);
+      _parserToken(session);
+      return;
+    }
+    else
+    {
+      session->args++; //-- we have an arg
+      len--;                   //-- we remove the null terminator
+      linebuffer[len++] = ' '; //-- and replace it with a space
+      if (len >= MAX_NETWORK_TEXT)
       {
-        while (client->available())
-          c = client->read();
+        ioStreamPrintf(client, "Error: parameters for %s are too long\n", active_cmd->name);
+        _parserSessionReset(session);
+        _parserResponseEnd(session);
+        return;
       }
-#endif
+    }
+    session->len = len;
+    session->token_start = len;
+    //DEBUGSERIAL.printf("%s need %d arg(s) has %d = %s\r\n", active_cmd->name, active_cmd->args, session->args, linebuffer);
+    if ((active_cmd->args > session->args) || ((session->delimiter != '\n') && _parserArgsOptional(session)))
+      return;
+    _parserArgsComplete(session);
+    return;
+  }
+
+  _parserRun(session);
+
+} //  _parserToken()
+
+
+//--------------------------------------------------------------------
+// the active command has its args; the abort state is checked before it is executed
+static void _parserRun(parserSession_t *session)
+{
+  const parserCmd_t *active_cmd = session->active_cmd;
+  char *linebuffer = session->linebuffer;
+
+  if (session->program)
+  {
+    _parserProgramAdd(session);
+    _parserSessionReset(session);
+    return;
+  }
+
+  DEBUG("checking command: #%d %s\n", session->command_id, linebuffer);
+
+  if (session->abort_processing)
+  {
+    if (active_cmd->abortable)
+    {
+      DEBUG("Aborting CMD: %s %s\n", active_cmd->name, linebuffer);
+      //-- skip everything else if this command has a stream as its last parameter
+      if (active_cmd->has_stream)
+      {
+        session->streaming = true;
+        session->skip_line = false;
+      }
+      session->command_id = PARSER_CMD_NONE;
     }
     else
     {
-      VERBOSE("empty command\n");
+      DEBUG("Non-Abortable CMD: %s %s\n", active_cmd->name, linebuffer);
     }
+  }
 
-  } while (client->available());
+  //-- RUN nests; it does not go through the frame of _parserExecute() with the locals of all handlers
+  if (session->command_id != PARSER_CMD_RUN)
+  {
+    _parserExecute(session);
+    return;
+  }
+  parserRunCommandFile(session->client, linebuffer, session->abort_processing);
+  _parserSessionReset(session);
+  _parserResponseEnd(session);
+
+} //  _parserRun()
+
+
+//--------------------------------------------------------------------
+// tokenize a chunk of input; a stream command takes the rest of the chunk
+// a command which sends a file stops the tokenizer until the file is sent; returns the bytes used
+static size_t _parserFeed(parserSession_t *session, uint8_t *chunk, size_t count)
+{
+  size_t i = 0;
 
-  // this should never occur but it's here just in case
-  if (active_file)
+  //-- with the exception of a stream, commands do not split across lines.
+  //-- commands with streams will start the stream on a new line.
+  while ((i < count) && !session->sending)
   {
-    //filesysSaveFinish();
-    //-aaw- ioStreamPrintf(client, "Received %d bytes\n", data_size_processed);
-    DEBUGSERIAL.printf("Received %d bytes\n", data_size_processed);
+    if (session->streaming)
+    {
+      //-- a command with a stream consumes everything up to the end of the session
+      _parserSaveStreamData(session, chunk + i, count - i);
+      return count;
+    }
+
+    //-- we process commands and arguments the same - both assume
+    //-- whitespace as a delimeter
+    char c = chunk[i++];
+    if (c == '\r')
+      continue;
+    if ((c == 0) || (c == ' ') || (c == '\n'))
+    {
+      session->delimiter = c;
+      if (session->len > session->token_start) // we can throw away leading white space
+        _parserToken(session);
+      else if ((c == '\n') && _parserArgsOptional(session))
+        _parserArgsComplete(session); //-- the line ends without the optional args
+      continue;
+    }
+
+    session->linebuffer[session->len++] = c;
+    // we chunk large streams of data
+    if (session->len >= MAX_NETWORK_TEXT)
+    {
+      session->delimiter = 0;
+      _parserToken(session);
+    }
   }
+  return i;
+
+} //  _parserFeed()
+
+
+//--------------------------------------------------------------------
+// the session ends: a file which is being sent gets one more burst and the rest is dropped
+static void _parserSendDrain(parserSession_t *session)
+{
+  if (!session->sending)
+    return;
+  _parserSendFileData(session, false);
+  if (session->sending)
+  {
+    DEBUG("output dropped: the client did not take all of the file\n");
+    _parserSendFileFinish(session);
+  }
+
+} //  _parserSendDrain()
+
+
+/* --
+#### parserSessionBegin()
+
+Start a parser session on a Stream. The session keeps all parser state between calls so commands
+may arrive in any number of pieces. Feed the session with parserSessionPoll() and close it with parserSessionEnd().
+
+- input: session **parserSession_t ptr** the session storage; it is owned by the caller
+- input: client **Stream ptr** an active Stream with the commands and data to be processes
+- input: aborted **bool** indicates a prior command aborted
+- input: out_buf **uint8_t ptr** CORK_SIZE bytes for the output; NULL to allocate them when needed
+-- */
+
+void parserSessionBegin(parserSession_t *session, Stream *client, bool aborted, uint8_t *out_buf)
+{
+  //-- a nested session (a command file) shares the cork of the outer session
+  if (!corkStream::of(client))
+  {
+    session->cork.begin(client, out_buf);
+    client = &(session->cork);
+  }
+  session->client = client;
+  session->abort_processing = aborted;
+  session->streaming = false;
+  session->skip_line = false;
+  session->stream_mode = PARSER_STREAM_DISCARD;
+  session->delimiter = 0;
+  session->data_size_processed = 0;
+  session->sending = false;
+  session->send_file = File();
+  session->send_lz = false;
+  session->send_buf = NULL;
+  session->program = NULL;
+  session->input = NULL;
+  session->input_pos = 0;
+  session->input_len = 0;
+  session->keep_alive = false;
+  session->responding = false;
+  _parserSessionReset(session);
+}
+
+/* --
+#### parserSessionPoll()
+
+Consume whatever data the session Stream has available and return immediately.
+A partial command or arg is kept and continued on the next call.
+While a stream is stored, data is left with the client when the file system can not keep up.
+A command which sends a file is followed by a part of the file on each call; the input after
+the command is parsed once the file has been sent.
+
+- input: session **parserSession_t ptr** an active session
+- return: **bool** `false` when processing has been aborted
+-- */
+
+bool parserSessionPoll(parserSession_t *session)
+{
+  Stream *client = session->client;
+  if (!client)
+    return false;
+
+  //-- output of a previous command goes first; no new commands are read until it is sent
+  if (session->sending)
+  {
+    _parserSendFileData(session, false);
+    if (session->sending)
+    {
+      client->flush();
+      return (!session->abort_processing);
+    }
+  }
+
+  //-- the input which waited for the output comes before anything new; a file to send stops the
+  //-- parsing and its output goes out with the following polls
+  size_t limit;
+  while (!session->sending)
+  {
+    if ((session->input_pos == session->input_len) && (!(limit = _parserChunkLimit(session)) || !_parserReadInput(session, limit)))
+      break;
+    session->input_pos += _parserFeed(session, session->input + session->input_pos, session->input_len - session->input_pos);
+  }
+
+  //-- the output of everything that arrived goes out together
+  client->flush();
+  return (!session->abort_processing);
+}
+
+/* --
+#### parserSessionEnd()
+
+The input of the session is complete. A pending token is processed as if it was delimited,
+a stream command finishes and the session becomes inactive.
+Nothing waits for the client: output which it does not take right away is dropped, also when
+the client has gone.
+
+- input: session **parserSession_t ptr** an active session
+- return: **bool** `false` when processing has been aborted
+-- */
+
+bool parserSessionEnd(parserSession_t *session)
+{
+  if (!session->client)
+    return false;
+
+  //-- the input which waited for the output is parsed; every file to send gets one burst
+  _parserSendDrain(session);
+  while (session->input_pos < session->input_len)
+  {
+    session->input_pos += _parserFeed(session, session->input + session->input_pos, session->input_len - session->input_pos);
+    _parserSendDrain(session);
+  }
+
+  session->delimiter = '\n';
+  if (!session->streaming && (session->len > session->token_start))
+    _parserToken(session);
+  if (_parserArgsOptional(session))
+    _parserArgsComplete(session);
+
+  if (session->active_cmd)
+  {
+    //-- a command file with an incomplete command does not run, like one with an unknown command
+    if (session->program)
+      session->program->failed = true;
+    ioStreamPrintf(session->client, "Error: %s needs %d parameter(s)\n", session->active_cmd->name, session->active_cmd->args);
+  }
+
+  _parserSendDrain(session);
+  _parserSaveStreamFinish(session);
 
   VERBOSE("done with commands\n");
-  // handle any responces to send back to connected source
-  //client->flush();
-  return (!abort_processing);
+  bool success = !session->abort_processing;
+  session->streaming = false;
+  _parserResponseEnd(session);
+  session->client = NULL;
+  session->cork.end();
+  free(session->input);
+  session->input = NULL;
+  _parserSessionReset(session);
+  return success;
+}
+
+/* --
+#### parserSessionBusy()
+
+- input: session **parserSession_t ptr** an active session
+- return: **bool** `true` while output or input is pending; keep polling the session even when the client sends nothing
+-- */
+
+bool parserSessionBusy(parserSession_t *session)
+{
+  return (session->client && (session->sending || (session->input_pos < session->input_len)));
+}
+
+/* --
+#### parserSessionKeepAlive()
+
+- input: session **parserSession_t ptr** an active session
+- return: **bool** `true` after the client sent `KEEPALIVE`; the connection stays open while the client is silent
+-- */
+
+bool parserSessionKeepAlive(parserSession_t *session)
+{
+  return (session->client && session->keep_alive);
+}
+
+// -------- command files --------------------------------------------------------------------
+
+static parserProgram_t _parser_programs[PARSER_PROGRAM_CACHE];
+static uint32_t _parser_program_clock = 0; // orders the cache entries by their last use
+static uint8_t _parser_run_depth = 0;
+
+/*
+  the sessions of command files are not on the loop task stack either. every RUN level executes in
+  its own session. a file is compiled by one session which records the commands without running
+  them, so compiling never nests; the file is read into its own buffer because the input of the
+  session which started the RUN is still being parsed.
+
+  what remains on the stack per RUN level is _parserRun() -> parserRunCommandFile(), about 320 bytes
+  on a host build at -O2 (-fstack-usage). RUN bypasses _parserExecute() (816 bytes there), so that
+  frame is only paid once, by the command at the bottom. at PARSER_RUN_DEPTH 3 the worst case is
+  about 2.5 KB above the loop task's parserSessionPoll().
+*/
+static parserSession_t _parser_run_sessions[PARSER_RUN_DEPTH];
+static parserSession_t _parser_compile_session;
+static uint8_t _parser_compile_chunk[PARSER_COMPILE_CHUNK];
+
+//--------------------------------------------------------------------
+static void _parserProgramRelease(parserProgram_t *program)
+{
+  free(program->steps);
+  free(program->pool);
+  memset(program, 0, sizeof(parserProgram_t));
+
+} //  _parserProgramRelease()
+
+
+//--------------------------------------------------------------------
+// the file has changed; its program can not be used again
+static void _parserProgramForget(const char *name)
+{
+  char *filename = _filesys_fix_name(name);
+  for (int i = 0; i < PARSER_PROGRAM_CACHE; i++)
+  {
+    parserProgram_t *program = &(_parser_programs[i]);
+    if (!program->name[0] || (strcmp(program->name, filename) != 0))
+      continue;
+    if (program->running)
+      program->stale = true;
+    else
+      _parserProgramRelease(program);
+  }
+
+} //  _parserProgramForget()
+
+
+//--------------------------------------------------------------------
+// the compiling session has a complete command; it becomes the next step of the program
+static void _parserProgramAdd(parserSession_t *session)
+{
+  parserProgram_t *program = session->program;
+  const parserCmd_t *active_cmd = session->active_cmd;
+
+  if (active_cmd->has_stream)
+  {
+    ioStreamPrintf(session->client, "Error: %s can not be used in a command file\n", active_cmd->name);
+    program->failed = true;
+    _parserStreamBegin(session); //-- the rest of the file would have been the stream
+    return;
+  }
+
+  //-- commands without args leave their own name (blanked) in the linebuffer
+  const char *args = ((active_cmd->id > PARSER_CMD_HELP) && ((active_cmd->args + active_cmd->opt_args) > 0)) ? session->linebuffer : "";
+  size_t len = strlen(args) + 1;
+
+  if (program->step_count == program->step_room)
+  {
+    uint16_t room = program->step_room ? (program->step_room * 2) : 16;
+    parserStep_t *steps = (parserStep_t *)realloc(program->steps, room * sizeof(parserStep_t));
+    if (!steps)
+    {
+      program->failed = true;
+      return;
+    }
+    program->steps = steps;
+    program->step_room = room;
+  }
+  if ((program->pool_len + len) > program->pool_room)
+  {
+    uint32_t room = program->pool_room ? (program->pool_room * 2) : 256;
+    while (room < (program->pool_len + len))
+      room *= 2;
+    char *pool = (room <= 0xFFFF) ? (char *)realloc(program->pool, room) : NULL;
+    if (!pool)
+    {
+      ioStreamPrintf(session->client, "Error: command file is too large\n");
+      program->failed = true;
+      return;
+    }
+    program->pool = pool;
+    program->pool_room = room;
+  }
+
+  parserStep_t *step = &(program->steps[program->step_count++]);
+  step->cmd = active_cmd - _parser_commands;
+  step->args = session->args;
+  step->arg_offset = program->pool_len;
+  memcpy(program->pool + program->pool_len, args, len);
+  program->pool_len += len;
+
+} //  _parserProgramAdd()
+
+
+//--------------------------------------------------------------------
+// the file is tokenized exactly like commands from a client; the commands are recorded instead of executed
+static bool _parserProgramCompile(parserProgram_t *program, Stream *client, File *file)
+{
+  parserSession_t *session = &_parser_compile_session;
+  size_t count;
+
+  parserSessionBegin(session, client, false);
+  session->program = program;
+  while ((count = file->read(_parser_compile_chunk, PARSER_COMPILE_CHUNK)) > 0)
+    _parserFeed(session, _parser_compile_chunk, count);
+  parserSessionEnd(session);
+  return !program->failed;
+
+} //  _parserProgramCompile()
+
+
+//--------------------------------------------------------------------
+// the cached program of the file; the file is compiled when it is not cached or it has changed
+static parserProgram_t *_parserProgramLoad(Stream *client, const char *name, bool *cached)
+{
+  File file = filesysOpen(name, "r");
+  if (!file)
+    return NULL;
+  char filename[MAX_FILENAME_LEN + 1];
+  strcpy(filename, _filesys_fix_name(name)); //-- the fixed name is in a shared buffer
+  uint32_t size = file.size();
+  time_t mtime = file.getLastWrite();
+
+  parserProgram_t *slot = NULL;
+  for (int i = 0; i < PARSER_PROGRAM_CACHE; i++)
+  {
+    parserProgram_t *program = &(_parser_programs[i]);
+    if (program->name[0] && !program->stale && (strcmp(program->name, filename) == 0) && (program->size == size) && (program->mtime == mtime))
+    {
+      filesysClose(file);
+      program->last_used = ++_parser_program_clock;
+      *cached = true;
+      return program;
+    }
+  }
+  _parserProgramForget(filename);
+
+  //-- a free entry or else the least recently used one which is not running
+  for (int i = 0; i < PARSER_PROGRAM_CACHE; i++)
+  {
+    parserProgram_t *program = &(_parser_programs[i]);
+    if (program->running)
+      continue;
+    if (!program->name[0])
+    {
+      slot = program;
+      break;
+    }
+    if (!slot || (program->last_used < slot->last_used))
+      slot = program;
+  }
+  if (!slot)
+  {
+    filesysClose(file);
+    ioStreamPrintf(client, "Error: too many nested command files\n");
+    return NULL;
+  }
+
+  _parserProgramRelease(slot);
+  strcpy(slot->name, filename);
+  slot->size = size;
+  slot->mtime = mtime;
+  bool success = _parserProgramCompile(slot, client, &file);
+  filesysClose(file);
+  if (!success)
+  {
+    _parserProgramRelease(slot);
+    return NULL;
+  }
+  slot->last_used = ++_parser_program_clock;
+  *cached = false;
+  return slot;
+
+} //  _parserProgramLoad()
+
+
+/* --
+#### parserRunCommandFile()
+
+Execute the commands of a command file. The file is parsed once into a list of commands which is
+kept until the file changes, so later runs only execute. The parse and execute times are reported.
+
+- input: client **Stream ptr** receives the output of the commands
+- input: name **char ptr** the command file
+- input: aborted **bool** indicates a prior command aborted
+- return: **bool** `false` when the file could not be run or processing has been aborted
+-- */
+
+bool parserRunCommandFile(Stream *client, const char *name, bool aborted)
+{
+  if (_parser_run_depth >= PARSER_RUN_DEPTH)
+  {
+    ioStreamPrintf(client, "Error: too many nested command files\n");
+    return false;
+  }
+
+  uint32_t start = micros();
+  bool cached = false;
+  parserProgram_t *program = _parserProgramLoad(client, name, &cached);
+  if (!program)
+  {
+    ioStreamPrintf(client, "Error: unable to run command file %s\n", name);
+    return false;
+  }
+  uint32_t parsed = micros();
+
+  parserSession_t *session = &(_parser_run_sessions[_parser_run_depth]);
+  program->running++;
+  _parser_run_depth++;
+
+  parserSessionBegin(session, client, aborted);
+  for (uint16_t i = 0; i < program->step_count; i++)
+  {
+    parserStep_t *step = &(program->steps[i]);
+    session->active_cmd = &(_parser_commands[step->cmd]);
+    session->command_id = session->active_cmd->id;
+    session->args = step->args;
+    strcpy(session->linebuffer, program->pool + step->arg_offset);
+    session->len = strlen(session->linebuffer);
+    _parserRun(session);
+    //-- the output of a command is complete before the next one starts
+    _parserSendFileData(session, true);
+  }
+  bool success = parserSessionEnd(session);
+
+  _parser_run_depth--;
+  program->running--;
+
+  uint32_t done = micros();
+  ioStreamPrintf(client, "Ran %s: %u commands, parse %u us%s, execute %u us\n", name, program->step_count,
+                 parsed - start, cached ? " (cached)" : "", done - parsed);
+  if (program->stale && !program->running)
+    _parserProgramRelease(program);
+  return success;
+}
+
+/* --
+#### parserProcessCommands()
+
+Process a Stream of commands. The most common Stream source is the TCP data. Any Stream is
+supported provided it implements read(), write(), and all print...() methods.
+
+This is a one shot session: only the data which is available now is processed. It suits complete
+input such as the memory buffer. Streams where data trickles in use a parserSession_t instead.
+
+- input: client **Stream ptr** an active Stream with the commands and data to be processes
+- input: aborted **bool** indicates a prior command aborted
+-- */
+
+bool parserProcessCommands(Stream *client, bool aborted)
+{
+
+  if (!client)
+  {
+    // oops - we cant work without a connected client
+    MESSAGE("PARSER processing client not available");
+    return false;
+  }
+  DEBUG("parserProcessCommands()...\n");
+
+  parserSession_t session;
+  parserSessionBegin(&session, client, aborted);
+  do
+  {
+    parserSessionPoll(&session);
+  } while (parserSessionBusy(&session) || (client->available() > 0));
+  return parserSessionEnd(&session);
 }
 
 #endif
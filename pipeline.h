@@ -0,0 +1,310 @@
+#ifndef __PIPELINE_H
+#define __PIPELINE_H
+
+/* ***************************************************************************
+* File:    pipeline
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### PIPELINE API
+
+A producer/consumer pipe. The producer writes into a ringStream of PIPELINE_BLOCKS blocks
+while a writer drains it into a sink function, one block at a time and straight from the ring.
+
+On the ESP32 the writer is a FreeRTOS task pinned to the core which does not run loop(),
+so flash writes do not stall the network receive. Elsewhere the writer is a std::thread
+which makes it possible to exercise the pipe on a host with any sink (eg a plain file).
+
+The ring is a single producer / single consumer ring, so the data itself needs no lock.
+The two sides only wake each other: the producer when a block is complete, the writer when
+it has returned a block. When the ring is full, pipelineWritable() returns 0. The producer
+should stop taking data from its source until the writer returns a block.
+--- */
+
+#include <atomic>
+#ifndef ESP32
+  #include <thread>
+  #include <mutex>
+  #include <condition_variable>
+#endif
+
+#define PIPELINE_BLOCK_SIZE      4096
+#define PIPELINE_BLOCKS          2
+#define PIPELINE_WRITER_CORE     0    // the Arduino loop() runs on core 1
+#define PIPELINE_WRITER_PRIORITY 1
+#define PIPELINE_WRITER_STACK    4096
+
+typedef bool (*pipelineSink_t)(void *ctx, const uint8_t *buf, size_t len);
+
+// an event is a binary semaphore: a signal is kept until the other side waits for it
+#ifdef ESP32
+typedef SemaphoreHandle_t pipelineEvent_t;
+#else
+typedef struct
+{
+  std::mutex lock;
+  std::condition_variable changed;
+  bool signaled;
+} _pipelineEvent;
+typedef _pipelineEvent *pipelineEvent_t;
+#endif
+
+typedef struct
+{
+  ringStream *ring;
+  uint32_t written;             // bytes written by the producer; a block is complete at each multiple of PIPELINE_BLOCK_SIZE
+  pipelineEvent_t data;         // the producer completed a block or is finished
+  pipelineEvent_t room;         // the writer returned a block
+  pipelineSink_t sink;
+  void *ctx;
+  std::atomic<bool> finishing;  // the producer is done; the writer drains the ring and ends
+  std::atomic<bool> error;      // the sink failed; the rest of the data is dropped
+  bool active;
+#ifdef ESP32
+  pipelineEvent_t done;         // the writer task has ended
+#else
+  std::thread *writer;
+#endif
+} pipeline_t;
+
+// -------- events --------------------------------------------------------------------
+
+#ifdef ESP32
+
+static pipelineEvent_t _pipelineEventCreate()
+{
+  return xSemaphoreCreateBinary();
+}
+
+static void _pipelineEventDelete(pipelineEvent_t event)
+{
+  vSemaphoreDelete(event);
+}
+
+static void _pipelineSignal(pipelineEvent_t event)
+{
+  xSemaphoreGive(event);
+}
+
+static void _pipelineWait(pipelineEvent_t event)
+{
+  xSemaphoreTake(event, portMAX_DELAY);
+}
+
+#else
+
+static pipelineEvent_t _pipelineEventCreate()
+{
+  _pipelineEvent *event = new _pipelineEvent;
+  event->signaled = false;
+  return event;
+}
+
+static void _pipelineEventDelete(pipelineEvent_t event)
+{
+  delete event;
+}
+
+static void _pipelineSignal(pipelineEvent_t event)
+{
+  std::lock_guard<std::mutex> guard(event->lock);
+  event->signaled = true;
+  event->changed.notify_one();
+}
+
+static void _pipelineWait(pipelineEvent_t event)
+{
+  std::unique_lock<std::mutex> guard(event->lock);
+  event->changed.wait(guard, [event] { return event->signaled; });
+  event->signaled = false;
+}
+
+#endif
+
+// -------- writer --------------------------------------------------------------------
+
+static void _pipelineWriter(void *arg)
+{
+  pipeline_t *pipe = (pipeline_t *)arg;
+  const uint8_t *block;
+
+  while (true)
+  {
+    //-- everything the producer wrote before it set finishing is in the ring
+    bool finishing = pipe->finishing.load(std::memory_order_acquire);
+    size_t len = pipe->ring->peekSpan(&block);
+
+    //-- the writer consumes whole blocks, so a block never wraps; only the last one may be short
+    if (len > PIPELINE_BLOCK_SIZE)
+      len = PIPELINE_BLOCK_SIZE;
+    if ((len < PIPELINE_BLOCK_SIZE) && !finishing)
+    {
+      _pipelineWait(pipe->data);
+      continue;
+    }
+    if (!len)
+      break;
+
+    if (!pipe->error && !(*pipe->sink)(pipe->ctx, block, len))
+      pipe->error = true;
+    pipe->ring->consume(len);
+    _pipelineSignal(pipe->room);
+  }
+
+#ifdef ESP32
+  // tell the producer we are done with the pipe
+  _pipelineSignal(pipe->done);
+  vTaskDelete(NULL);
+#endif
+}
+
+// -------- producer --------------------------------------------------------------------
+
+static void _pipelineRelease(pipeline_t *pipe)
+{
+  delete pipe->ring;
+  pipe->ring = NULL;
+  if (pipe->data)
+    _pipelineEventDelete(pipe->data);
+  if (pipe->room)
+    _pipelineEventDelete(pipe->room);
+  pipe->data = NULL;
+  pipe->room = NULL;
+#ifdef ESP32
+  if (pipe->done)
+    _pipelineEventDelete(pipe->done);
+  pipe->done = NULL;
+#endif
+  pipe->active = false;
+}
+
+/* ---
+#### pipelineBegin()
+
+Allocate the ring and start the writer.
+
+- input: pipe **pipeline_t ptr** the pipe storage; it is owned by the caller
+- input: sink **pipelineSink_t** called by the writer for every block; it returns `false` on failure
+- input: ctx **void ptr** passed to the sink
+- return: **bool** `true` on success and `false` on failure
+--- */
+bool pipelineBegin(pipeline_t *pipe, pipelineSink_t sink, void *ctx)
+{
+  pipe->sink = sink;
+  pipe->ctx = ctx;
+  pipe->written = 0;
+  pipe->finishing = false;
+  pipe->error = false;
+  pipe->active = true;
+  pipe->ring = new ringStream(PIPELINE_BLOCKS * PIPELINE_BLOCK_SIZE);
+  pipe->data = _pipelineEventCreate();
+  pipe->room = _pipelineEventCreate();
+#ifdef ESP32
+  pipe->done = _pipelineEventCreate();
+  bool success = pipe->ring && pipe->ring->capacity() && pipe->data && pipe->room && pipe->done;
+#else
+  bool success = pipe->ring && pipe->ring->capacity() && pipe->data && pipe->room;
+#endif
+  if (!success)
+  {
+    _pipelineRelease(pipe);
+    return false;
+  }
+
+#ifdef ESP32
+  if (xTaskCreatePinnedToCore(_pipelineWriter, "pipeline", PIPELINE_WRITER_STACK, pipe, PIPELINE_WRITER_PRIORITY, NULL, PIPELINE_WRITER_CORE) != pdPASS)
+  {
+    _pipelineRelease(pipe);
+    return false;
+  }
+#else
+  pipe->writer = new std::thread(_pipelineWriter, pipe);
+#endif
+  return true;
+}
+
+/* ---
+#### pipelineWritable()
+
+- input: pipe **pipeline_t ptr** an active pipe
+- return: **size_t** the number of bytes pipelineWrite() accepts without waiting; 0 while the ring is full
+--- */
+size_t pipelineWritable(pipeline_t *pipe)
+{
+  if (!pipe->active)
+    return 0;
+  return pipe->ring->availableForWrite();
+}
+
+/* ---
+#### pipelineWrite()
+
+Copy the data into the ring. The writer is woken for every block which is completed.
+It only waits for the writer when more is written than pipelineWritable() reported.
+
+- input: pipe **pipeline_t ptr** an active pipe
+- input: buf **uint8_t ptr** the data
+- input: len **size_t** the number of bytes
+- return: **bool** `false` once the sink has failed
+--- */
+bool pipelineWrite(pipeline_t *pipe, const uint8_t *buf, size_t len)
+{
+  if (!pipe->active)
+    return false;
+
+  while (len)
+  {
+    size_t count = pipe->ring->write(buf, len);
+    if (!count)
+    {
+      _pipelineWait(pipe->room);
+      continue;
+    }
+    buf += count;
+    len -= count;
+
+    uint32_t before = pipe->written;
+    pipe->written += count;
+    if ((before / PIPELINE_BLOCK_SIZE) != (pipe->written / PIPELINE_BLOCK_SIZE))
+      _pipelineSignal(pipe->data);
+  }
+  return !pipe->error;
+}
+
+/* ---
+#### pipelineFinish()
+
+Let the writer store the partial block, wait for the writer to complete and release the pipe.
+
+- input: pipe **pipeline_t ptr** an active pipe
+- return: **bool** `true` when the sink accepted all data
+--- */
+bool pipelineFinish(pipeline_t *pipe)
+{
+  if (!pipe->active)
+    return false;
+
+  pipe->finishing.store(true, std::memory_order_release);
+  _pipelineSignal(pipe->data);
+
+#ifdef ESP32
+  _pipelineWait(pipe->done);
+#else
+  pipe->writer->join();
+  delete pipe->writer;
+  pipe->writer = NULL;
+#endif
+
+  bool success = !pipe->error;
+  _pipelineRelease(pipe);
+  return success;
+}
+
+#endif
+
+/*eof*/
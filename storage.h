@@ -0,0 +1,374 @@
+#ifndef __STORAGE_H
+#define __STORAGE_H
+
+/* ***************************************************************************
+* File:    storage
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### STORAGE API
+
+The file system functions (see filesys.h) do not use SPIFFS directly; they go through
+a storage backend. A backend is a set of function vectors which mount the storage and
+open, test and remove files. Files are Arduino `File` objects, so everything above the
+backend - uploads, CAT, the directory index - is the same for all backends.
+
+There are two backends:
+
+- `g_storage_spiffs` is the SPIFFS on the flash; it is the default on the ESP32.
+- `g_storage_host` keeps the files in a directory of the host (STORAGE_HOST_ROOT) and is the default
+  elsewhere. A file which is opened for reading is mapped into memory with `mmap()` so reads are a `memcpy()`.
+  This makes it possible to run the command engine as a host program to profile it and to measure
+  its throughput without an ESP32.
+
+A backend may be chosen with storageSelect() before filesysInit() is called.
+
+_NOTE: All paths start with '/'; the storage is flat and "/" opens the directory listing._
+--- */
+
+typedef struct storageBackend_s
+{
+  const char *name;                                 // for messages
+  bool (*begin)();                                  // mount the storage; false when it can not be used
+  File (*open)(const char *path, const char *mode); // an invalid File when the file can not be opened
+  bool (*exists)(const char *path);
+  bool (*remove)(const char *path);
+} storageBackend_t;
+
+
+// -------- SPIFFS --------------------------------------------------------------------
+
+static bool _storageSpiffsBegin()
+{
+  if (SPIFFS.begin())
+    return true;
+  return SPIFFS.begin(true); // attempt to format SPIFFS
+}
+
+static File _storageSpiffsOpen(const char *path, const char *mode)
+{
+  return SPIFFS.open(path, mode);
+}
+
+static bool _storageSpiffsExists(const char *path)
+{
+  return SPIFFS.exists(path);
+}
+
+static bool _storageSpiffsRemove(const char *path)
+{
+  return SPIFFS.remove(path);
+}
+
+static const storageBackend_t g_storage_spiffs = {"SPIFFS", _storageSpiffsBegin, _storageSpiffsOpen, _storageSpiffsExists, _storageSpiffsRemove};
+
+
+// -------- host directory --------------------------------------------------------------------
+#ifndef ESP32
+
+#include <FSImpl.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifndef STORAGE_HOST_ROOT
+  #define STORAGE_HOST_ROOT "spiffs" // relative to the working directory of the program
+#endif
+#define STORAGE_HOST_PATH_LEN 256
+
+static char _storage_host_root[STORAGE_HOST_PATH_LEN] = STORAGE_HOST_ROOT;
+
+// a file of the host directory; a file opened with "r" is mapped, anything else uses the file descriptor
+class storageHostFile : public fs::FileImpl
+{
+private:
+  char full_path[STORAGE_HOST_PATH_LEN + MAX_FILENAME_LEN + 1];
+  const char *file_path; // the "/name" part of full_path
+  int fd;
+  DIR *dir;              // only for "/"
+  uint8_t *map;
+  size_t map_len;
+  size_t map_pos;
+  bool mapped;
+
+public:
+  storageHostFile(const char *path, const char *mode)
+  {
+    int root_len = snprintf(full_path, sizeof(full_path), "%s", _storage_host_root);
+    snprintf(full_path + root_len, sizeof(full_path) - root_len, "%s", path);
+    file_path = full_path + root_len;
+    fd = -1;
+    dir = NULL;
+    map = NULL;
+    map_len = 0;
+    map_pos = 0;
+    mapped = false;
+
+    if (!strcmp(path, "/"))
+    {
+      dir = opendir(_storage_host_root);
+      return;
+    }
+
+    int flags = O_RDONLY;
+    if (mode[0] == 'w')
+    {
+      //-- a new file replaces the old one; a reader which has the old file mapped keeps its content
+      unlink(full_path);
+      flags = O_CREAT | O_TRUNC | ((mode[1] == '+') ? O_RDWR : O_WRONLY);
+    }
+    else if (mode[0] == 'a')
+      flags = O_CREAT | O_APPEND | ((mode[1] == '+') ? O_RDWR : O_WRONLY);
+    else if (mode[1] == '+')
+      flags = O_RDWR;
+    fd = ::open(full_path, flags, 0644);
+    if ((fd < 0) || (flags != O_RDONLY))
+      return;
+
+    struct stat st;
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode))
+    {
+      ::close(fd);
+      fd = -1;
+      return;
+    }
+    //-- the file is mapped by the first read; a directory listing only needs the size
+    mapped = true;
+    map_len = st.st_size;
+  }
+
+  bool mapFile()
+  {
+    map = (uint8_t *)mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+      map = NULL;
+      mapped = false; // read through the file descriptor instead
+      return lseek(fd, map_pos, SEEK_SET) >= 0;
+    }
+    madvise(map, map_len, MADV_SEQUENTIAL);
+    return true;
+  }
+
+  ~storageHostFile()
+  {
+    close();
+  }
+
+  size_t write(const uint8_t *buf, size_t size)
+  {
+    if (mapped || (fd < 0))
+      return 0;
+    size_t done = 0;
+    while (done < size)
+    {
+      ssize_t count = ::write(fd, buf + done, size - done);
+      if (count <= 0)
+        break;
+      done += count;
+    }
+    return done;
+  }
+
+  size_t read(uint8_t *buf, size_t size)
+  {
+    if (mapped && !map && (map_pos < map_len) && !mapFile())
+      return 0;
+    if (mapped)
+    {
+      if (size > (map_len - map_pos))
+        size = map_len - map_pos;
+      memcpy(buf, map + map_pos, size);
+      map_pos += size;
+      return size;
+    }
+    if (fd < 0)
+      return 0;
+    ssize_t count = ::read(fd, buf, size);
+    return (count > 0) ? count : 0;
+  }
+
+  void flush()
+  {
+    // writes are not buffered
+  }
+
+  bool seek(uint32_t pos, SeekMode mode)
+  {
+    if (mapped)
+    {
+      size_t base = (mode == SeekSet) ? 0 : (mode == SeekCur) ? map_pos : map_len;
+      if ((base + pos) > map_len)
+        return false;
+      map_pos = base + pos;
+      return true;
+    }
+    if (fd < 0)
+      return false;
+    return lseek(fd, pos, (mode == SeekSet) ? SEEK_SET : (mode == SeekCur) ? SEEK_CUR : SEEK_END) >= 0;
+  }
+
+  size_t position() const
+  {
+    if (mapped)
+      return map_pos;
+    off_t pos = (fd < 0) ? 0 : lseek(fd, 0, SEEK_CUR);
+    return (pos < 0) ? 0 : pos;
+  }
+
+  size_t size() const
+  {
+    if (mapped)
+      return map_len;
+    struct stat st;
+    if ((fd < 0) || fstat(fd, &st))
+      return 0;
+    return st.st_size;
+  }
+
+  bool setBufferSize(size_t size)
+  {
+    return true;
+  }
+
+  void close()
+  {
+    if (map)
+      munmap(map, map_len);
+    map = NULL;
+    mapped = false;
+    if (fd >= 0)
+      ::close(fd);
+    fd = -1;
+    if (dir)
+      closedir(dir);
+    dir = NULL;
+  }
+
+  time_t getLastWrite()
+  {
+    struct stat st;
+    if ((fd < 0) || fstat(fd, &st))
+      return 0;
+    return st.st_mtime;
+  }
+
+  const char *path() const
+  {
+    return file_path;
+  }
+
+  const char *name() const
+  {
+    return file_path + 1;
+  }
+
+  boolean isDirectory(void)
+  {
+    return dir != NULL;
+  }
+
+  fs::FileImplPtr openNextFile(const char *mode)
+  {
+    char path[MAX_FILENAME_LEN + 2];
+    struct dirent *entry;
+    while (dir && (entry = readdir(dir)))
+    {
+      if ((entry->d_type != DT_REG) || (strlen(entry->d_name) > MAX_FILENAME_LEN))
+        continue;
+      snprintf(path, sizeof(path), "/%s", entry->d_name);
+      fs::FileImplPtr file = std::make_shared<storageHostFile>(path, mode);
+      if (*file)
+        return file;
+    }
+    return fs::FileImplPtr();
+  }
+
+  void rewindDirectory(void)
+  {
+    if (dir)
+      rewinddir(dir);
+  }
+
+  operator bool()
+  {
+    return (fd >= 0) || (dir != NULL);
+  }
+};
+
+static bool _storageHostBegin()
+{
+  struct stat st;
+  if (stat(_storage_host_root, &st))
+    mkdir(_storage_host_root, 0755);
+  return !stat(_storage_host_root, &st) && S_ISDIR(st.st_mode);
+}
+
+static File _storageHostOpen(const char *path, const char *mode)
+{
+  fs::FileImplPtr file = std::make_shared<storageHostFile>(path, mode);
+  if (!*file)
+    return File();
+  return File(file);
+}
+
+static bool _storageHostExists(const char *path)
+{
+  char full_path[STORAGE_HOST_PATH_LEN + MAX_FILENAME_LEN + 1];
+  struct stat st;
+  snprintf(full_path, sizeof(full_path), "%s%s", _storage_host_root, path);
+  return !stat(full_path, &st);
+}
+
+static bool _storageHostRemove(const char *path)
+{
+  char full_path[STORAGE_HOST_PATH_LEN + MAX_FILENAME_LEN + 1];
+  snprintf(full_path, sizeof(full_path), "%s%s", _storage_host_root, path);
+  return !unlink(full_path);
+}
+
+static const storageBackend_t g_storage_host = {"host directory", _storageHostBegin, _storageHostOpen, _storageHostExists, _storageHostRemove};
+
+/* ---
+#### storageHostRoot()
+
+Set the directory of the host backend. It must be called before filesysInit().
+
+- input: root **char ptr** the directory; it is created when it does not exist
+--- */
+void storageHostRoot(const char *root)
+{
+  snprintf(_storage_host_root, sizeof(_storage_host_root), "%s", root);
+}
+
+#endif
+
+
+#ifdef ESP32
+static const storageBackend_t *g_storage = &g_storage_spiffs;
+#else
+static const storageBackend_t *g_storage = &g_storage_host;
+#endif
+
+/* ---
+#### storageSelect()
+
+Choose the storage backend. It must be called before filesysInit().
+
+- input: backend **storageBackend_t ptr** `g_storage_spiffs`, `g_storage_host` or a backend of your own
+--- */
+void storageSelect(const storageBackend_t *backend)
+{
+  g_storage = backend;
+}
+
+#endif
+
+/*eof*/
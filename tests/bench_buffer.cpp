@@ -0,0 +1,134 @@
+/* ***************************************************************************
+* File:    tests/bench_buffer.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### BUFFER BENCHMARK
+
+The cost of a byte in the buffers of bufferstream.h: the segmented bufferStream, whose size
+is given at run time, and fixedBufferStream<N>, whose size is a power of two known when it is
+compiled. Both are MAX_INPUT_BUFFER bytes. Batches of bytes are written and read back:
+
+- per byte: write(uint8_t) and read() through a Stream pointer, as print() and the parser reach them
+- bulk: write(data, len) and readBytes() through a Stream pointer, as a chunked upload does
+- span: writeSpan()/commit() and peekSpan()/consume() on the buffer itself, with no copy in
+  or out beyond the memcpy() into the span
+
+- usage: bench_buffer [megabytes]
+--- */
+
+#include "cmdParser.ino"
+
+#include <chrono>
+
+#define BENCH_BATCH 1000 // bytes written before they are read; less than a segment
+
+static volatile uint32_t _bench_sink;
+
+//--------------------------------------------------------------------------
+// ns for a byte written and read again
+static double _benchBytes(Stream *buf, size_t total)
+{
+  uint32_t sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t done = 0; done < total; done += BENCH_BATCH)
+  {
+    for (int i = 0; i < BENCH_BATCH; i++)
+      buf->write((uint8_t)i);
+    for (int i = 0; i < BENCH_BATCH; i++)
+      sum += buf->read();
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  _bench_sink += sum;
+  return elapsed.count() / total;
+
+} //  _benchBytes()
+
+
+//--------------------------------------------------------------------------
+static double _benchBulk(Stream *buf, size_t total)
+{
+  uint8_t data[BENCH_BATCH];
+  uint8_t back[BENCH_BATCH];
+  uint32_t sum = 0;
+  for (int i = 0; i < BENCH_BATCH; i++)
+    data[i] = i;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t done = 0; done < total; done += BENCH_BATCH)
+  {
+    buf->write(data, BENCH_BATCH);
+    buf->readBytes((char *)back, BENCH_BATCH);
+    sum += back[done % BENCH_BATCH];
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  _bench_sink += sum;
+  return elapsed.count() / total;
+
+} //  _benchBulk()
+
+
+//--------------------------------------------------------------------------
+// a batch may need two spans around the wrap point
+template <typename BUFFER> static double _benchSpan(BUFFER *buf, size_t total)
+{
+  uint8_t data[BENCH_BATCH];
+  uint32_t sum = 0;
+  for (int i = 0; i < BENCH_BATCH; i++)
+    data[i] = i;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t done = 0; done < total; done += BENCH_BATCH)
+  {
+    size_t count = 0;
+    uint8_t *span;
+    while (count < BENCH_BATCH)
+    {
+      size_t len = buf->writeSpan(&span);
+      if (len > (BENCH_BATCH - count))
+        len = BENCH_BATCH - count;
+      memcpy(span, data + count, len);
+      buf->commit(len);
+      count += len;
+    }
+    const uint8_t *unread;
+    while ((count = buf->peekSpan(&unread)) > 0)
+    {
+      sum += unread[count - 1];
+      buf->consume(count);
+    }
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  _bench_sink += sum;
+  return elapsed.count() / total;
+
+} //  _benchSpan()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  size_t total = ((argc > 1) ? atol(argv[1]) : 64) << 20;
+
+  bufferStream segmented(MAX_INPUT_BUFFER);
+  static fixedBufferStream<MAX_INPUT_BUFFER> fixed;
+  Stream *buffers[] = {&segmented, &fixed};
+  static const char *names[] = {"bufferStream", "fixedBufferStream"};
+
+  printf("%u byte buffers, %zu MB\n", (unsigned)MAX_INPUT_BUFFER, total >> 20);
+  printf("%-18s %9s %9s %9s\n", "ns/byte", "per byte", "bulk", "span");
+  for (int i = 0; i < 2; i++)
+  {
+    double per_byte = _benchBytes(buffers[i], total);
+    double bulk = _benchBulk(buffers[i], total);
+    double span = i ? _benchSpan(&fixed, total) : _benchSpan(&segmented, total);
+    printf("%-18s %9.3f %9.3f %9.3f\n", names[i], per_byte, bulk, span);
+  }
+  return 0;
+
+} //  main()
+
+/*eof*/
@@ -0,0 +1,97 @@
+/* ***************************************************************************
+* File:    tests/bench_crc.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### CRC BENCHMARK
+
+The slice-by-8 CRC32 of digest.h against the one table, one byte per step loop it replaces
+and the bitwise loop, on the blocks an upload hands to the digest. digestUpdate(), which adds
+the SHA-256, is reported too. The kernels must agree on the check value of "123456789".
+
+- usage: bench_crc [megabytes] [block size]
+--- */
+
+#include "cmdParser.ino"
+
+#include <chrono>
+
+static volatile uint32_t _bench_sink;
+
+static uint32_t _benchBytewise(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  crc = ~crc;
+  while (len--)
+    crc = _digest_crc_table[0][(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+static uint32_t _benchBitwise(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  crc = ~crc;
+  while (len--)
+  {
+    crc ^= *buf++;
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320UL : 0);
+  }
+  return ~crc;
+}
+
+//--------------------------------------------------------------------------
+template <typename KERNEL> static double _benchKernel(const std::string &data, size_t total, size_t block, KERNEL kernel)
+{
+  uint32_t crc = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t done = 0; done < total; done += block)
+    crc = kernel(crc, (const uint8_t *)data.data() + (done % data.size()), block);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  _bench_sink += crc;
+  return total / elapsed.count() / 1e6;
+
+} //  _benchKernel()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  size_t total = ((argc > 1) ? atol(argv[1]) : 256) << 20;
+  size_t block = (argc > 2) ? atol(argv[2]) : FILESYS_BLOCK_SIZE;
+
+  //-- the tables are built by digestBegin()
+  digest_t digest;
+  digestBegin(&digest);
+  const uint8_t *check = (const uint8_t *)"123456789";
+  if ((digestCrc32(0, check, 9) != 0xCBF43926) || (_benchBytewise(0, check, 9) != 0xCBF43926) || (_benchBitwise(0, check, 9) != 0xCBF43926))
+  {
+    printf("a kernel got the wrong CRC\n");
+    return 1;
+  }
+
+  //-- a block wraps the 64 KB of data, so every block starts at the same alignment
+  std::string data;
+  unsigned int seed = 1;
+  while (data.size() < 65536)
+    data += (char)rand_r(&seed);
+  total -= total % block;
+
+  printf("%zu MB in %zu byte blocks\n", total >> 20, block);
+  printf("%-14s %8.1f MB/s\n", "slice-by-8", _benchKernel(data, total, block, digestCrc32));
+  printf("%-14s %8.1f MB/s\n", "bytewise", _benchKernel(data, total, block, _benchBytewise));
+  printf("%-14s %8.1f MB/s\n", "bitwise", _benchKernel(data, total / 8, block, _benchBitwise));
+#ifdef DIGEST_SHA256
+  printf("%-14s %8.1f MB/s\n", "digestUpdate", _benchKernel(data, total / 8, block, [&digest](uint32_t crc, const uint8_t *buf, size_t len) {
+    digestUpdate(&digest, buf, len);
+    return digest.crc;
+  }));
+#endif
+  return 0;
+
+} //  main()
+
+/*eof*/
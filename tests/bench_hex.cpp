@@ -0,0 +1,69 @@
+/* ***************************************************************************
+* File:    tests/bench_hex.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### HEX BENCHMARK
+
+The speed of the Intel HEX decoder of hexfile.h on a firmware image (see corpus.h), in MB of
+HEX text and in MB of decoded data per second. The text is handed over in pieces of
+PARSER_CHUNK_SIZE bytes unless a size is given (filesysReadHex() reads 512), and the sink
+only counts the blocks.
+
+- usage: bench_hex [megabytes of HEX text] [piece size]
+--- */
+
+#include "cmdParser.ino"
+#include "corpus.h"
+
+#include <chrono>
+
+static bool _benchSink(void *ctx, uint32_t address, const uint8_t *data, size_t len)
+{
+  *(size_t *)ctx += len;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+static void _benchImage(const char *name, const std::string &text, size_t piece, int rounds)
+{
+  hexDecoder_t hex;
+  size_t decoded = 0;
+  uint8_t error = HEX_OK;
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; round++)
+  {
+    hexBegin(&hex, _benchSink, &decoded);
+    for (size_t pos = 0; pos < text.size(); pos += piece)
+      hexDecode(&hex, (const uint8_t *)text.data() + pos, ((text.size() - pos) < piece) ? (text.size() - pos) : piece);
+    error |= hexFinish(&hex);
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  double seconds = elapsed.count();
+
+  printf("%-12s %9zu -> %9zu bytes %8.1f MB/s text %8.1f MB/s data %s\n", name, text.size(), decoded / rounds,
+         (double)text.size() * rounds / seconds / 1e6, (double)decoded / seconds / 1e6, error ? hexErrorText(error) : "");
+
+} //  _benchImage()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  size_t size = ((argc > 1) ? atol(argv[1]) : 8) << 20;
+  size_t piece = (argc > 2) ? atol(argv[2]) : PARSER_CHUNK_SIZE;
+
+  //-- 16 data bytes take 45 characters, 32 take 77
+  printf("%zu MB of HEX text in %zu byte pieces\n", size >> 20, piece);
+  _benchImage("16 per line", corpusHex(corpusBinary(size * 16 / 45, 1), 0x08000000, 16), piece, 4);
+  _benchImage("32 per line", corpusHex(corpusBinary(size * 32 / 77, 2), 0x08000000, 32), piece, 4);
+  return 0;
+
+} //  main()
+
+/*eof*/
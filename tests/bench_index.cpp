@@ -0,0 +1,135 @@
+/* ***************************************************************************
+* File:    tests/bench_index.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### INDEX BENCHMARK
+
+The RAM index of filesys.h against the storage it stands in for. The files are created in
+a host directory through the host backend of storage.h, the file-backed stand-in for SPIFFS.
+Every case runs once with the index and once after the index is dropped, which is what
+filesys.h does when the index can not be allocated: then each lookup goes to the storage.
+
+- build: the one full scan of filesysInit()
+- dir: a DIR command through a parser session, all files and a pattern
+- exists / size: filesysExists() and filesysGetSize(), half of them for missing files
+
+The storage on the host is the page cache, so on the device the gap is much larger.
+
+- usage: bench_index <directory for the files> [files]
+--- */
+
+#include "cmdParser.ino"
+#include "mockstream.h"
+#include "testfiles.h"
+
+#include <chrono>
+
+#define BENCH_FILES       1000
+#define BENCH_LOOKUPS     20000
+
+static volatile int32_t _bench_sink;
+
+static double _benchSeconds(std::chrono::steady_clock::time_point start)
+{
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+static void _benchReport(const char *name, bool index, size_t rounds, double seconds)
+{
+  printf("%-12s %-7s %12.2f us\n", name, index ? "index" : "storage", seconds / rounds * 1e6);
+}
+
+//--------------------------------------------------------------------------
+static void _benchDir(const char *name, const char *command, bool index, size_t rounds)
+{
+  std::string input;
+  for (size_t i = 0; i < rounds; i++)
+    input += command;
+  mockStream client(input);
+  client.keep_output = false;
+  parserSession_t session;
+
+  auto start = std::chrono::steady_clock::now();
+  parserSessionBegin(&session, &client, false);
+  while (client.available() || parserSessionBusy(&session))
+    parserSessionPoll(&session);
+  parserSessionEnd(&session);
+  _benchReport(name, index, rounds, _benchSeconds(start));
+
+} //  _benchDir()
+
+
+//--------------------------------------------------------------------------
+static void _benchLookups(size_t files, bool index)
+{
+  char name[MAX_FILENAME_LEN + 1];
+  unsigned int seed = 1;
+  int32_t found = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_LOOKUPS; i++)
+  {
+    //-- the odd numbers are missing
+    snprintf(name, sizeof(name), "file%04u.txt", (unsigned int)((rand_r(&seed) % files) * 2 + (i & 1)));
+    found += filesysExists(name);
+  }
+  _benchReport("exists", index, BENCH_LOOKUPS, _benchSeconds(start));
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_LOOKUPS; i++)
+  {
+    snprintf(name, sizeof(name), "file%04u.txt", (unsigned int)((rand_r(&seed) % files) * 2 + (i & 1)));
+    found += filesysGetSize(name);
+  }
+  _benchReport("size", index, BENCH_LOOKUPS, _benchSeconds(start));
+  _bench_sink += found;
+
+} //  _benchLookups()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  size_t files = (argc > 2) ? atol(argv[2]) : BENCH_FILES;
+  testFilesBegin((argc > 1) ? argv[1] : NULL);
+  parserInit();
+
+  //-- the even numbers; the sizes vary, so DIR formats bytes and KB
+  char name[MAX_FILENAME_LEN + 1];
+  for (size_t i = 0; i < files; i++)
+  {
+    snprintf(name, sizeof(name), "file%04u.txt", (unsigned int)(i * 2));
+    testFilesWrite(name, std::string(1 + (i * 37) % 3000, 'x'));
+  }
+  printf("%zu files\n", files);
+
+  auto start = std::chrono::steady_clock::now();
+  _filesys_index_build();
+  _benchReport("build", true, 1, _benchSeconds(start));
+
+  for (int index = 1; index >= 0; index--)
+  {
+    if (!index)
+      _filesys_index_drop();
+    _benchDir("dir", "dir\n", index, 20);
+    _benchDir("dir pattern", "dir file1*\n", index, 20);
+    _benchLookups(files, index);
+  }
+
+  for (size_t i = 0; i < files; i++)
+  {
+    snprintf(name, sizeof(name), "file%04u.txt", (unsigned int)(i * 2));
+    filesysDelete(name);
+  }
+  return 0;
+
+} //  main()
+
+/*eof*/
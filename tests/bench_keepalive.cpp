@@ -0,0 +1,142 @@
+/* ***************************************************************************
+* File:    tests/bench_keepalive.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### KEEPALIVE BENCHMARK
+
+Commands/s of one client on the TCP server of the sketch, on the loopback interface (see tcpload.h).
+
+- one-shot: a connection per command, as `echo size x | nc -N`; the client closes its side after
+  the command, so the server ends the batch at once instead of after TCP_IDLE_TIMEOUT
+- keep-alive: one KEEPALIVE connection; each command waits for the response of the one before
+- pipelined: one KEEPALIVE connection; the commands are sent in batches and the responses read after
+
+SIZE is answered in the poll which reads it. CAT sends the file on the following polls, which
+are WIFI_BUSY_WAIT apart unless the socket of the session wakes select(), as the close of a
+one-shot client does. Loopback has no round trip time to speak of; over WiFi each handshake of
+one-shot costs much more.
+
+- usage: bench_keepalive <directory for the files> [commands]
+--- */
+
+#define LOG_LEVEL 1 // messages only; the debug records of every command would flood the log ring
+
+#include "cmdParser.ino"
+#include "testfiles.h"
+#include "tcpload.h"
+
+#include <chrono>
+
+#define BENCH_COMMANDS 2000
+#define BENCH_BATCH    50
+
+static double _benchSeconds(std::chrono::steady_clock::time_point start)
+{
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+static void _benchReport(const char *command, const char *mode, int commands, int failures, double seconds)
+{
+  printf("%-5s %-11s %6d commands %9.0f commands/s %8.1f us/command %s\n", command, mode, commands, commands / seconds, seconds / commands * 1e6,
+         failures ? "WRONG RESPONSES" : "");
+}
+
+//--------------------------------------------------------------------------
+// every response must be the expected one
+static void _benchOneShot(const char *name, const std::string &command, const std::string &expect, int commands)
+{
+  int failures = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < commands; i++)
+  {
+    tcpLoadClient_t client;
+    if (!tcpLoadConnect(&client) || !tcpLoadSend(&client, command) || shutdown(client.fd, SHUT_WR) || (tcpLoadReadAll(&client) != expect))
+      failures++;
+    tcpLoadClose(&client);
+  }
+  _benchReport(name, "one-shot", commands, failures, _benchSeconds(start));
+
+} //  _benchOneShot()
+
+
+//--------------------------------------------------------------------------
+// batch 1 waits for each response before the next command
+static void _benchKeepAlive(const char *name, const char *mode, const std::string &command, const std::string &expect, int commands, int batch)
+{
+  tcpLoadClient_t client;
+  std::string body;
+  bool ok = false;
+  int failures = 0;
+  if (!tcpLoadConnect(&client) || !tcpLoadSend(&client, "keepalive\n") || !tcpLoadReply(&client, &body, &ok))
+  {
+    printf("%s %s: no connection\n", name, mode);
+    return;
+  }
+
+  std::string text;
+  for (int i = 0; i < batch; i++)
+    text += command;
+  auto start = std::chrono::steady_clock::now();
+  for (int done = 0; done < commands; done += batch)
+  {
+    if (!tcpLoadSend(&client, text))
+      break;
+    for (int i = 0; i < batch; i++)
+    {
+      if (!tcpLoadReply(&client, &body, &ok) || !ok || (body != expect))
+        failures++;
+    }
+  }
+  _benchReport(name, mode, commands, failures, _benchSeconds(start));
+  tcpLoadClose(&client);
+
+} //  _benchKeepAlive()
+
+
+//--------------------------------------------------------------------------
+static void _benchCommand(const char *name, const std::string &command, const std::string &expect, int commands)
+{
+  _benchOneShot(name, command, expect, commands);
+  _benchKeepAlive(name, "keep-alive", command, expect, commands, 1);
+  _benchKeepAlive(name, "pipelined", command, expect, commands, BENCH_BATCH);
+
+} //  _benchCommand()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  int commands = (argc > 2) ? atoi(argv[2]) : BENCH_COMMANDS;
+  commands -= commands % BENCH_BATCH;
+  tcpLoadSetup((argc > 1) ? argv[1] : NULL);
+  std::string file;
+  for (int i = 0; i < 4; i++)
+    file += "line " + std::to_string(i) + " of the file which is sent by CAT\n";
+  testFilesWrite("load.txt", file);
+
+  //-- the response of SIZE is taken from the first one-shot command
+  tcpLoadServerBegin();
+  tcpLoadClient_t client;
+  std::string size;
+  if (tcpLoadConnect(&client) && tcpLoadSend(&client, "size load.txt\n") && !shutdown(client.fd, SHUT_WR))
+    size = tcpLoadReadAll(&client);
+  tcpLoadClose(&client);
+  printf("SIZE responds %s", size.c_str());
+
+  _benchCommand("SIZE", "size load.txt\n", size, commands);
+  _benchCommand("CAT", "cat load.txt\n", file, commands);
+  tcpLoadServerEnd();
+
+  filesysDelete("load.txt");
+  return 0;
+
+} //  main()
+
+/*eof*/
@@ -0,0 +1,176 @@
+/* ***************************************************************************
+* File:    tests/bench_lookup.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### LOOKUP BENCHMARK
+
+The command lookup of the parser: the hash index of _parserFindCommand() against the
+strcasecmp() scan it replaced. The real table is measured first. Tables of 6, 64 and 512
+generated names then use the same _parserHash() and probing as the parser, with the index
+sized the same way (a power of 2 of at least twice the number of commands).
+
+Three quarters of the lookups hit a command, in mixed case; the others miss.
+
+- usage: bench_lookup [lookups per table]
+--- */
+
+#include "cmdParser.ino"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#define BENCH_LOOKUPS 2000000
+
+static volatile uintptr_t _bench_sink;
+
+typedef struct
+{
+  std::vector<std::string> names;
+  std::vector<uint16_t> index; // name index + 1; 0 marks an empty slot
+  uint16_t mask;
+} benchTable_t;
+
+//--------------------------------------------------------------------------
+static void _benchBuild(benchTable_t *table, size_t count, uint32_t *seed)
+{
+  static const char letters[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+  while (table->names.size() < count)
+  {
+    std::string name;
+    size_t len = 3 + (rand_r(seed) % 7);
+    for (size_t i = 0; i < len; i++)
+      name += letters[rand_r(seed) % ((i == 0) ? 26 : 36)];
+    bool unique = true;
+    for (const std::string &other : table->names)
+      unique = unique && strcasecmp(other.c_str(), name.c_str());
+    if (unique)
+      table->names.push_back(name);
+  }
+
+  size_t slots = 8;
+  while (slots < (2 * count))
+    slots <<= 1;
+  table->mask = slots - 1;
+  table->index.assign(slots, 0);
+  for (size_t i = 0; i < count; i++)
+  {
+    uint16_t slot = _parserHash(table->names[i].c_str()) & table->mask;
+    while (table->index[slot])
+      slot = (slot + 1) & table->mask;
+    table->index[slot] = i + 1;
+  }
+
+} //  _benchBuild()
+
+
+//--------------------------------------------------------------------------
+static const char *_benchFind(const benchTable_t *table, const char *name)
+{
+  uint16_t slot = _parserHash(name) & table->mask;
+  while (table->index[slot])
+  {
+    const char *candidate = table->names[table->index[slot] - 1].c_str();
+    if (strcasecmp(candidate, name) == 0)
+      return candidate;
+    slot = (slot + 1) & table->mask;
+  }
+  return NULL;
+
+} //  _benchFind()
+
+
+//--------------------------------------------------------------------------
+static const char *_benchScan(const benchTable_t *table, const char *name)
+{
+  for (const std::string &candidate : table->names)
+  {
+    if (strcasecmp(candidate.c_str(), name) == 0)
+      return candidate.c_str();
+  }
+  return NULL;
+
+} //  _benchScan()
+
+
+//--------------------------------------------------------------------------
+// the tokens to look up: 3 of 4 are names of the table with a random case, the others are not in it
+static std::vector<std::string> _benchTokens(const std::vector<std::string> &names, uint32_t *seed)
+{
+  std::vector<std::string> tokens;
+  for (int i = 0; i < 1024; i++)
+  {
+    std::string token = names[rand_r(seed) % names.size()];
+    for (char &c : token)
+    {
+      if (rand_r(seed) & 1)
+        c = tolower(c);
+    }
+    if ((i % 4) == 3)
+      token += "Q";
+    tokens.push_back(token);
+  }
+  return tokens;
+
+} //  _benchTokens()
+
+
+//--------------------------------------------------------------------------
+template <typename LOOKUP> static double _benchTime(const std::vector<std::string> &tokens, long lookups, LOOKUP lookup)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < lookups; i++)
+    _bench_sink += (uintptr_t)lookup(tokens[i & 1023].c_str());
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / lookups;
+
+} //  _benchTime()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  long lookups = (argc > 1) ? atol(argv[1]) : BENCH_LOOKUPS;
+  uint32_t seed = 1;
+
+  printf("%-12s %8s %12s %12s %8s\n", "table", "commands", "scan ns", "hash ns", "speedup");
+
+  //-- the command table of the parser
+  std::vector<std::string> names;
+  for (size_t i = 0; i < PARSER_CMD_COUNT; i++)
+    names.push_back(_parser_commands[i].name);
+  std::vector<std::string> tokens = _benchTokens(names, &seed);
+  double scan = _benchTime(tokens, lookups, [](const char *name) -> const void *
+  {
+    for (size_t i = 0; i < PARSER_CMD_COUNT; i++)
+    {
+      if (strcasecmp(_parser_commands[i].name, name) == 0)
+        return &(_parser_commands[i]);
+    }
+    return NULL;
+  });
+  double hash = _benchTime(tokens, lookups, _parserFindCommand);
+  printf("%-12s %8zu %12.1f %12.1f %7.1fx\n", "parser", (size_t)PARSER_CMD_COUNT, scan, hash, scan / hash);
+
+  //-- generated tables
+  static const size_t counts[] = {6, 64, 512};
+  for (size_t count : counts)
+  {
+    benchTable_t table;
+    _benchBuild(&table, count, &seed);
+    tokens = _benchTokens(table.names, &seed);
+    scan = _benchTime(tokens, lookups, [&table](const char *name) { return _benchScan(&table, name); });
+    hash = _benchTime(tokens, lookups, [&table](const char *name) { return _benchFind(&table, name); });
+    printf("%-12s %8zu %12.1f %12.1f %7.1fx\n", "generated", count, scan, hash, scan / hash);
+  }
+  return 0;
+
+} //  main()
+
+/*eof*/
@@ -0,0 +1,99 @@
+/* ***************************************************************************
+* File:    tests/bench_lz.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### LZ BENCHMARK
+
+The ratio and the speed of the codec of lzstream.h on the data which is transferred most:
+command and config text, Intel HEX and, for the worst case, random bytes (see corpus.h).
+The data goes through in the chunks a transfer uses: PARSER_CHUNK_SIZE bytes of input to
+the encoder and CORK_SIZE bytes of output from it. Both speeds are in MB of uncompressed data.
+
+- usage: bench_lz [megabytes]
+--- */
+
+#include "cmdParser.ino"
+#include "corpus.h"
+
+#include <chrono>
+
+static double _benchSeconds(std::chrono::steady_clock::time_point start)
+{
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+//--------------------------------------------------------------------------
+static void _benchCorpus(const char *name, const std::string &data)
+{
+  static uint8_t buf[CORK_SIZE];
+  std::string packed;
+
+  lzEncoder_t enc;
+  lzEncoderBegin(&enc);
+  auto start = std::chrono::steady_clock::now();
+  size_t pos = 0;
+  for (;;)
+  {
+    size_t in_len = data.size() - pos;
+    if (in_len > PARSER_CHUNK_SIZE)
+      in_len = PARSER_CHUNK_SIZE;
+    bool finish = ((pos + in_len) == data.size());
+    size_t count = lzEncode(&enc, (const uint8_t *)data.data() + pos, &in_len, buf, sizeof(buf), finish);
+    pos += in_len;
+    packed.append((const char *)buf, count);
+    if (finish && (pos == data.size()) && !count)
+      break;
+  }
+  double compress = _benchSeconds(start);
+  lzEncoderEnd(&enc);
+
+  lzDecoder_t dec;
+  lzDecoderBegin(&dec);
+  size_t unpacked = 0;
+  start = std::chrono::steady_clock::now();
+  pos = 0;
+  for (;;)
+  {
+    size_t in_len = packed.size() - pos;
+    if (in_len > CORK_SIZE)
+      in_len = CORK_SIZE;
+    size_t count = lzDecode(&dec, (const uint8_t *)packed.data() + pos, &in_len, buf, sizeof(buf));
+    pos += in_len;
+    unpacked += count;
+    if ((pos == packed.size()) && !count)
+      break;
+  }
+  double decompress = _benchSeconds(start);
+  bool valid = lzDecoderEnd(&dec) && (unpacked == data.size());
+
+  printf("%-6s %9zu -> %9zu bytes %5.2fx %8.2f MB/s compress %8.2f MB/s decompress %s\n", name, data.size(), packed.size(),
+         (double)data.size() / packed.size(), data.size() / compress / 1e6, data.size() / decompress / 1e6, valid ? "" : "WRONG SIZE");
+
+} //  _benchCorpus()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  size_t size = ((argc > 1) ? atol(argv[1]) : 8) << 20;
+
+  std::string random;
+  unsigned int seed = 1;
+  while (random.size() < size)
+    random += (char)rand_r(&seed);
+
+  _benchCorpus("text", corpusText(size, 1));
+  _benchCorpus("hex", corpusHex(corpusBinary(size * 4 / 11, 2), 0x08000000)); // about 11 characters per 4 bytes
+  _benchCorpus("random", random);
+  return 0;
+
+} //  main()
+
+/*eof*/
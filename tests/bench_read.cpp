@@ -0,0 +1,125 @@
+/* ***************************************************************************
+* File:    tests/bench_read.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### READ BENCHMARK
+
+The chunked input of the parser and of streamReadLine() against reading one byte per call.
+Each case reports the bytes/s and the read()/readBytes() calls per byte of input.
+
+- commands: a batch of short commands through a parser session
+- upload: an UPLOAD stream through a parser session
+- readline: the lines of a command file with streamReadLine()
+
+For the sessions, "per byte" is the same mock client with the Stream default readBytes(),
+which makes one read() per byte as the tokenizer did before. For readline it is the Stream
+version of streamReadLine() on the same file; "bulk" is the File version.
+
+- usage: bench_read <directory for the files> [upload size in KB]
+--- */
+
+#include "cmdParser.ino"
+#include "mockstream.h"
+
+#include <chrono>
+
+#define BENCH_COMMANDS    20000
+#define BENCH_UPLOAD_KB   4096
+#define BENCH_LINES       20000
+
+static double _benchSeconds(std::chrono::steady_clock::time_point start)
+{
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+static void _benchReport(const char *name, const char *mode, size_t bytes, size_t calls, double seconds)
+{
+  printf("%-10s %-9s %10zu bytes %9.2f MB/s %8.4f calls/byte\n", name, mode, bytes, bytes / seconds / 1e6, (double)calls / bytes);
+}
+
+//--------------------------------------------------------------------------
+// run the input through a session; all of it has arrived before the first poll
+static void _benchSession(const char *name, const std::string &input, bool bulk)
+{
+  mockStream client(input);
+  client.bulk = bulk;
+  client.keep_output = false;
+  parserSession_t session;
+
+  auto start = std::chrono::steady_clock::now();
+  parserSessionBegin(&session, &client, false);
+  while (client.available() || parserSessionBusy(&session))
+    parserSessionPoll(&session);
+  parserSessionEnd(&session);
+  _benchReport(name, bulk ? "chunked" : "per byte", input.size(), client.read_calls, _benchSeconds(start));
+
+} //  _benchSession()
+
+
+//--------------------------------------------------------------------------
+static void _benchReadLine(bool bulk)
+{
+  char line[MAX_NETWORK_TEXT + 1];
+  size_t bytes = 0;
+  size_t calls = 0;
+
+  File file = g_storage->open("/bench.cmd", "r");
+  auto start = std::chrono::steady_clock::now();
+  for (;;)
+  {
+    uint16_t len = bulk ? streamReadLine(&file, line, sizeof(line), false) : streamReadLine((Stream *)&file, line, sizeof(line), false);
+    if (!len)
+      break;
+    bytes += len;
+    calls += bulk ? 1 : len; // the Stream version makes a read() per byte
+  }
+  double seconds = _benchSeconds(start);
+  file.close();
+  _benchReport("readline", bulk ? "bulk" : "per byte", bytes, calls, seconds);
+
+} //  _benchReadLine()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  if (argc > 1)
+    storageHostRoot(argv[1]);
+  size_t upload_kb = (argc > 2) ? atol(argv[2]) : BENCH_UPLOAD_KB;
+  filesysInit();
+  parserInit();
+
+  std::string commands;
+  for (int i = 0; i < BENCH_COMMANDS; i++)
+    commands += "size nosuch.bin\n";
+
+  std::string upload = "upload bench.bin\n";
+  for (size_t i = 0; i < (upload_kb * 1024); i++)
+    upload += (char)(i * 7);
+
+  File file = g_storage->open("/bench.cmd", "w");
+  for (int i = 0; i < BENCH_LINES; i++)
+    file.printf("info %d %d\n", i, BENCH_LINES - i);
+  file.close();
+
+  _benchSession("commands", commands, false);
+  _benchSession("commands", commands, true);
+  _benchSession("upload", upload, false);
+  _benchSession("upload", upload, true);
+  _benchReadLine(false);
+  _benchReadLine(true);
+
+  filesysDelete("bench.bin");
+  filesysDelete("bench.cmd");
+  return 0;
+
+} //  main()
+
+/*eof*/
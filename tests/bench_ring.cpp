@@ -0,0 +1,42 @@
+/* ***************************************************************************
+* File:    tests/bench_ring.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### RING BENCHMARK
+
+Throughput of the ringStream between a producer and a consumer thread (see ringload.h)
+for single bytes, copies of up to 1500 bytes and spans. It reports MB/s and the ns per call
+of either side which moved data.
+
+- usage: bench_ring [megabytes] [capacity]
+--- */
+
+#include "cmdParser.ino"
+#include "ringload.h"
+
+int main(int argc, char **argv)
+{
+  size_t total = ((argc > 1) ? atol(argv[1]) : 256) << 20;
+  uint32_t size = (argc > 2) ? atol(argv[2]) : (PIPELINE_BLOCKS * PIPELINE_BLOCK_SIZE);
+  static const char *names[] = {"bytes", "copies", "spans", "mixed"};
+
+  ringStream ring(size);
+  printf("%u byte ring\n", ring.capacity());
+  for (int mode = RING_LOAD_BYTES; mode <= RING_LOAD_MIXED; mode++)
+  {
+    //-- a byte per call is much slower; it gets a smaller share
+    size_t bytes = (mode == RING_LOAD_BYTES) ? (total / 16) : total;
+    ringLoad_t load = ringLoad(&ring, bytes, mode);
+    printf("%-7s %9.1f MB/s %8.1f ns/call %s\n", names[mode], bytes / load.seconds / 1e6, load.seconds * 1e9 / load.calls, load.errors ? "WRONG DATA" : "");
+  }
+  return 0;
+
+} //  main()
+
+/*eof*/
@@ -0,0 +1,122 @@
+#ifndef __CORPUS_H
+#define __CORPUS_H
+
+/* ***************************************************************************
+* File:    tests/corpus.h
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### TEST CORPORA
+
+Generated sample data for the codec and decoder tests and benchmarks, so nothing has to be
+checked in and every run sees the same bytes for the same seed.
+
+- corpusText(): command files and configs, the text which is uploaded most
+- corpusBinary(): a firmware image; a few byte values are much more frequent than the others
+- corpusHex(): a binary as Intel HEX with extended linear address records at every 64 KB
+--- */
+
+#include <string>
+
+static std::string corpusText(size_t size, unsigned int seed)
+{
+  static const char *words[] = {"upload", "cat", "dir", "info", "run", "hexinfo", "verify", "hash", "del",
+                                "wifi", "ssid", "password", "port", "timeout", "enable", "disable", "sensor",
+                                "interval", "threshold", "config", "firmware", "node", "gateway", "log"};
+  static const size_t count = sizeof(words) / sizeof(words[0]);
+  std::string text;
+  while (text.size() < size)
+  {
+    switch (rand_r(&seed) % 3)
+    {
+      case 0:
+        text += words[rand_r(&seed) % 9];
+        text += " ";
+        text += words[9 + (rand_r(&seed) % (count - 9))];
+        text += "_" + std::to_string(rand_r(&seed) % 100) + ".txt\n";
+        break;
+      case 1:
+        text += words[9 + (rand_r(&seed) % (count - 9))];
+        text += " = " + std::to_string(rand_r(&seed) % 10000) + "\n";
+        break;
+      default:
+        text += "# ";
+        for (int i = 0; i < 6; i++)
+        {
+          text += words[rand_r(&seed) % count];
+          text += (i < 5) ? " " : "\n";
+        }
+        break;
+    }
+  }
+  text.resize(size);
+  return text;
+}
+
+static std::string corpusBinary(size_t size, unsigned int seed)
+{
+  static const uint8_t common[] = {0x00, 0xFF, 0x01, 0x20, 0x46, 0x68, 0x70, 0xBD, 0xD0, 0xE0, 0xF0, 0x4B};
+  std::string data;
+  data.reserve(size);
+  while (data.size() < size)
+  {
+    unsigned int r = rand_r(&seed);
+    data += (char)((r & 1) ? common[(r >> 1) % sizeof(common)] : (r >> 8));
+  }
+  return data;
+}
+
+static void _corpusHexRecord(std::string *hex, uint8_t type, uint16_t address, const uint8_t *data, uint8_t len)
+{
+  static const char digits[] = "0123456789ABCDEF";
+  uint8_t record[4 + 255] = {len, (uint8_t)(address >> 8), (uint8_t)address, type};
+  if (len)
+    memcpy(record + 4, data, len);
+  uint8_t sum = 0;
+  *hex += ':';
+  for (int i = 0; i < (4 + len); i++)
+  {
+    *hex += digits[record[i] >> 4];
+    *hex += digits[record[i] & 0x0F];
+    sum += record[i];
+  }
+  sum = -sum;
+  *hex += digits[sum >> 4];
+  *hex += digits[sum & 0x0F];
+  *hex += "\r\n";
+}
+
+static std::string corpusHex(const std::string &data, uint32_t address, uint8_t record_len = 16)
+{
+  std::string hex;
+  uint32_t upper = 0xFFFFFFFF;
+  for (size_t pos = 0; pos < data.size();)
+  {
+    uint32_t at = address + pos;
+    if ((at >> 16) != upper)
+    {
+      upper = at >> 16;
+      uint8_t ela[2] = {(uint8_t)(upper >> 8), (uint8_t)upper};
+      _corpusHexRecord(&hex, 0x04, 0, ela, 2);
+    }
+    //-- a record does not cross a 64 KB boundary
+    size_t len = record_len;
+    if (len > (data.size() - pos))
+      len = data.size() - pos;
+    if (len > (0x10000 - (at & 0xFFFF)))
+      len = 0x10000 - (at & 0xFFFF);
+    _corpusHexRecord(&hex, 0x00, at & 0xFFFF, (const uint8_t *)data.data() + pos, len);
+    pos += len;
+  }
+  _corpusHexRecord(&hex, 0x01, 0, NULL, 0);
+  return hex;
+}
+
+#endif
+
+/*eof*/
@@ -0,0 +1,91 @@
+#ifndef __MOCKSTREAM_H
+#define __MOCKSTREAM_H
+
+/* ***************************************************************************
+* File:    tests/mockstream.h
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### MOCK STREAM
+
+A Stream for the host tests and benchmarks. The input is a string of which only the first
+`limit` bytes have "arrived"; raise the limit to deliver more. The output is collected.
+Every call which reads is counted, so a benchmark can report the calls per byte.
+A write may be made short, and the client may go away after some output.
+--- */
+
+#include <string>
+
+class mockStream : public Stream
+{
+public:
+  std::string in;
+  std::string out;
+  size_t pos = 0;
+  size_t limit = 0;
+  size_t read_calls = 0;     // read() and readBytes() calls
+  bool keep_output = true;   // a benchmark only counts the output
+  bool bulk = true;          // false: readBytes() takes one read() per byte, as the Stream default does
+  size_t write_max = 0;      // a write takes at most this many bytes; 0 for no limit
+  size_t out_max = (size_t)-1; // the client goes away once it has this much output
+  size_t write_calls = 0;
+
+  mockStream(const std::string &input = "") : in(input), limit(input.size()) {}
+
+  int available() override
+  {
+    return (int)(limit - pos);
+  }
+
+  int read() override
+  {
+    read_calls++;
+    return (pos < limit) ? (uint8_t)in[pos++] : -1;
+  }
+
+  int peek() override
+  {
+    return (pos < limit) ? (uint8_t)in[pos] : -1;
+  }
+
+  size_t readBytes(char *buffer, size_t length) override
+  {
+    if (!bulk)
+      return Stream::readBytes(buffer, length);
+    read_calls++;
+    if (length > (limit - pos))
+      length = limit - pos;
+    memcpy(buffer, in.data() + pos, length);
+    pos += length;
+    return length;
+  }
+
+  size_t write(uint8_t c) override
+  {
+    return write(&c, 1);
+  }
+
+  size_t write(const uint8_t *buffer, size_t size) override
+  {
+    write_calls++;
+    if (write_max && (size > write_max))
+      size = write_max;
+    if (size > (out_max - out.size()))
+      size = out_max - out.size();
+    if (keep_output)
+      out.append((const char *)buffer, size);
+    return size;
+  }
+
+  using Print::write;
+  using Stream::readBytes;
+};
+
+#endif
+
+/*eof*/
@@ -0,0 +1,166 @@
+#ifndef __RINGLOAD_H
+#define __RINGLOAD_H
+
+/* ***************************************************************************
+* File:    tests/ringload.h
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### RING LOAD
+
+Runs a producer thread and a consumer (the calling thread) over a ringStream. The producer
+writes a counting sequence which the consumer checks. The calls are chosen by the mode:
+single bytes (write/read), copies (write/readBytes) or spans (writeSpan/commit, peekSpan/consume).
+RING_LOAD_MIXED rotates through the three on both sides, so every pairing is exercised.
+A side which finds the ring full (or empty) yields and retries.
+--- */
+
+#include <chrono>
+#include <thread>
+
+#define RING_LOAD_BYTES 0
+#define RING_LOAD_COPY  1
+#define RING_LOAD_SPAN  2
+#define RING_LOAD_MIXED 3
+#define RING_LOAD_MAX   1500 // the largest piece of a copy or span call
+
+typedef struct
+{
+  size_t errors;    // bytes which were not the expected ones
+  size_t calls;     // producer and consumer calls which moved data
+  double seconds;
+} ringLoad_t;
+
+//--------------------------------------------------------------------------
+static void _ringLoadProduce(ringStream *ring, size_t total, int mode, size_t *calls)
+{
+  uint8_t buf[RING_LOAD_MAX];
+  size_t sent = 0;
+  uint32_t turn = 0;
+
+  while (sent < total)
+  {
+    int call = (mode == RING_LOAD_MIXED) ? (turn % 3) : mode;
+    turn++;
+    size_t count = 1 + ((turn * 2654435761u) % ((call == RING_LOAD_BYTES) ? 16 : RING_LOAD_MAX));
+    if (count > (total - sent))
+      count = total - sent;
+
+    if (call == RING_LOAD_BYTES)
+    {
+      for (size_t i = 0; i < count; sent++, i++)
+      {
+        while (!ring->write((uint8_t)sent))
+          std::this_thread::yield();
+        (*calls)++;
+      }
+    }
+    else if (call == RING_LOAD_COPY)
+    {
+      for (size_t i = 0; i < count; i++)
+        buf[i] = (uint8_t)(sent + i);
+      for (size_t done = 0; done < count;)
+      {
+        size_t written = ring->write(buf + done, count - done);
+        if (!written)
+          std::this_thread::yield();
+        else
+          (*calls)++;
+        done += written;
+      }
+      sent += count;
+    }
+    else
+    {
+      uint8_t *span;
+      size_t len = ring->writeSpan(&span);
+      if (!len)
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      if (len > count)
+        len = count;
+      for (size_t i = 0; i < len; i++)
+        span[i] = (uint8_t)(sent + i);
+      ring->commit(len);
+      (*calls)++;
+      sent += len;
+    }
+  }
+
+} //  _ringLoadProduce()
+
+
+//--------------------------------------------------------------------------
+static ringLoad_t ringLoad(ringStream *ring, size_t total, int mode)
+{
+  ringLoad_t load = {0, 0, 0};
+  size_t producer_calls = 0;
+  char buf[RING_LOAD_MAX];
+  size_t got = 0;
+  uint32_t turn = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  std::thread producer(_ringLoadProduce, ring, total, mode, &producer_calls);
+  while (got < total)
+  {
+    int call = (mode == RING_LOAD_MIXED) ? (turn % 3) : mode;
+    turn++;
+
+    if (call == RING_LOAD_BYTES)
+    {
+      int c = ring->read();
+      if (c < 0)
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      load.errors += (c != (uint8_t)got);
+      got++;
+    }
+    else if (call == RING_LOAD_COPY)
+    {
+      size_t count = ring->readBytes(buf, sizeof(buf));
+      if (!count)
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      for (size_t i = 0; i < count; i++)
+        load.errors += ((uint8_t)buf[i] != (uint8_t)(got + i));
+      got += count;
+    }
+    else
+    {
+      const uint8_t *span;
+      size_t count = ring->peekSpan(&span);
+      if (!count)
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      for (size_t i = 0; i < count; i++)
+        load.errors += (span[i] != (uint8_t)(got + i));
+      ring->consume(count);
+      got += count;
+    }
+    load.calls++;
+  }
+  producer.join();
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  load.seconds = elapsed.count();
+  load.calls += producer_calls;
+  return load;
+
+} //  ringLoad()
+
+#endif
+
+/*eof*/
@@ -0,0 +1,163 @@
+#ifndef __TCPLOAD_H
+#define __TCPLOAD_H
+
+/* ***************************************************************************
+* File:    tests/tcpload.h
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### TCP LOAD
+
+The sketch as a server on the loopback interface, and the clients which drive it. setup()
+runs on the calling thread, then loop() runs on a thread of its own until tcpLoadServerEnd().
+The ports are moved by HOST_PORT_OFFSET (see host/include/WiFi.h), which is derived from the
+process id, so a test and a benchmark can run at the same time.
+
+A client is a plain blocking socket. tcpLoadReply() reads one KEEPALIVE response: the text up
+to the status line `=OK <length>` or `=ERR <length>` whose length matches the bytes before it.
+--- */
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <netinet/tcp.h>
+
+typedef struct
+{
+  int fd;
+  std::string pending;  // received after the last response
+} tcpLoadClient_t;
+
+static std::atomic<bool> _tcp_load_running(false);
+static std::thread _tcp_load_server;
+static uint16_t _tcp_load_port;
+
+//--------------------------------------------------------------------------
+// the storage is started and emptied before setup(); files written after this are seen by the server
+static void tcpLoadSetup(const char *directory)
+{
+  char offset[8];
+  snprintf(offset, sizeof(offset), "%d", 20000 + (getpid() % 10000));
+  setenv("HOST_PORT_OFFSET", offset, 1);
+  _tcp_load_port = TCP_PORT + atoi(offset);
+  testFilesBegin(directory);
+  setup();
+}
+
+static void tcpLoadServerBegin()
+{
+  _tcp_load_running = true;
+  _tcp_load_server = std::thread([]()
+  {
+    while (_tcp_load_running)
+      loop();
+  });
+}
+
+static void tcpLoadServerEnd()
+{
+  _tcp_load_running = false;
+  _tcp_load_server.join();
+}
+
+//--------------------------------------------------------------------------
+static bool tcpLoadConnect(tcpLoadClient_t *client)
+{
+  client->pending.clear();
+  client->fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(_tcp_load_port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int value = 1;
+  setsockopt(client->fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+  if ((client->fd < 0) || connect(client->fd, (struct sockaddr *)&addr, sizeof(addr)))
+  {
+    if (client->fd >= 0)
+      close(client->fd);
+    client->fd = -1;
+    return false;
+  }
+  return true;
+}
+
+static void tcpLoadClose(tcpLoadClient_t *client)
+{
+  if (client->fd >= 0)
+    close(client->fd);
+  client->fd = -1;
+}
+
+static bool tcpLoadSend(tcpLoadClient_t *client, const std::string &text)
+{
+  size_t done = 0;
+  while (done < text.size())
+  {
+    ssize_t count = send(client->fd, text.data() + done, text.size() - done, MSG_NOSIGNAL);
+    if (count <= 0)
+      return false;
+    done += count;
+  }
+  return true;
+}
+
+// false once the server has closed the connection
+static bool _tcpLoadReceive(tcpLoadClient_t *client)
+{
+  char buf[4096];
+  ssize_t count = recv(client->fd, buf, sizeof(buf), 0);
+  if (count <= 0)
+    return false;
+  client->pending.append(buf, count);
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// one KEEPALIVE response; false when the connection closes before its status line
+static bool tcpLoadReply(tcpLoadClient_t *client, std::string *body, bool *ok)
+{
+  size_t from = 0;  // the text before has no status line
+  for (;;)
+  {
+    //-- a status line can only start after a newline or at the start, and must count the bytes before it
+    size_t pos = from;
+    for (; (pos = client->pending.find('=', pos)) != std::string::npos; pos++)
+    {
+      size_t end = client->pending.find('\n', pos);
+      if (end == std::string::npos)
+        break;
+      unsigned long len = 0;
+      char status[4] = "";
+      if ((pos && (client->pending[pos - 1] != '\n')) || (sscanf(client->pending.c_str() + pos, "=%3[A-Z] %lu", status, &len) != 2) || (len != pos))
+        continue;
+      *ok = !strcmp(status, "OK");
+      body->assign(client->pending, 0, pos);
+      client->pending.erase(0, end + 1);
+      return true;
+    }
+    from = (pos == std::string::npos) ? client->pending.size() : pos;
+    if (!_tcpLoadReceive(client))
+      return false;
+  }
+}
+
+// everything up to the end of the connection, eg the response of a one-shot batch
+static std::string tcpLoadReadAll(tcpLoadClient_t *client)
+{
+  while (_tcpLoadReceive(client))
+    ;
+  std::string text;
+  text.swap(client->pending);
+  return text;
+}
+
+#endif
+
+/*eof*/
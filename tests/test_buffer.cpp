@@ -0,0 +1,151 @@
+/* ***************************************************************************
+* File:    tests/test_buffer.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### BUFFER TEST
+
+The segmented bufferStream and the fixedBufferStream<N> ring against a std::deque which
+holds what they should hold. Random writes and reads of single bytes, copies and spans run
+the indices around the wrap point and across the segments many times; after every step the
+buffer must report the same size as the model and give back the same bytes.
+
+- usage: test_buffer [steps]
+--- */
+
+#include "cmdParser.ino"
+
+#include <deque>
+
+#define TEST_STEPS 200000
+
+//--------------------------------------------------------------------------
+// one random operation on the buffer and the model; returns an error message or NULL
+template <typename BUFFER> static const char *_testStep(BUFFER *buf, std::deque<uint8_t> *model, size_t capacity, unsigned int *seed)
+{
+  //-- the bytes are random; a counter would repeat with a period which divides the capacity
+  uint8_t data[3000];
+  size_t len = 1 + (rand_r(seed) % sizeof(data));
+  size_t room = capacity - model->size();
+
+  switch (rand_r(seed) % 6)
+  {
+    case 0:
+    {
+      uint8_t b = rand_r(seed);
+      size_t count = buf->write(b);
+      if (count != (room ? 1 : 0))
+        return "write() of a byte";
+      if (count)
+        model->push_back(b);
+    } break;
+    case 1:
+    {
+      for (size_t i = 0; i < len; i++)
+        data[i] = rand_r(seed);
+      size_t count = buf->write(data, len);
+      if (count != ((len < room) ? len : room))
+        return "write() of a copy took the wrong size";
+      model->insert(model->end(), data, data + count);
+    } break;
+    case 2:
+    {
+      int c = buf->read();
+      if (c != (model->empty() ? -1 : model->front()))
+        return "read() got the wrong byte";
+      if (!model->empty())
+        model->pop_front();
+    } break;
+    case 3:
+    {
+      size_t count = buf->readBytes(data, len);
+      if (count != ((len < model->size()) ? len : model->size()))
+        return "readBytes() got the wrong size";
+      for (size_t i = 0; i < count; i++)
+      {
+        if (data[i] != model->front())
+          return "readBytes() got the wrong data";
+        model->pop_front();
+      }
+    } break;
+    case 4:
+    {
+      const uint8_t *span;
+      size_t count = buf->peekSpan(&span);
+      if ((count > model->size()) || (!count && !model->empty()))
+        return "peekSpan() got the wrong size";
+      if (count > len)
+        count = len;
+      for (size_t i = 0; i < count; i++)
+      {
+        if (span[i] != (*model)[i])
+          return "peekSpan() got the wrong data";
+      }
+      buf->consume(count);
+      model->erase(model->begin(), model->begin() + count);
+    } break;
+    case 5:
+    {
+      uint8_t *span;
+      size_t count = buf->writeSpan(&span);
+      if ((count > room) || (!count && room))
+        return "writeSpan() got the wrong size";
+      if (count > len)
+        count = len;
+      for (size_t i = 0; i < count; i++)
+      {
+        span[i] = rand_r(seed);
+        model->push_back(span[i]);
+      }
+      buf->commit(count);
+    } break;
+  }
+  if ((size_t)buf->available() != model->size())
+    return "available() differs";
+  if (buf->peek() != (model->empty() ? -1 : model->front()))
+    return "peek() got the wrong byte";
+  return NULL;
+
+} //  _testStep()
+
+
+//--------------------------------------------------------------------------
+template <typename BUFFER> static int _testBuffer(const char *name, BUFFER *buf, size_t capacity, long steps)
+{
+  std::deque<uint8_t> model;
+  unsigned int seed = 1;
+  for (long step = 0; step < steps; step++)
+  {
+    const char *error = _testStep(buf, &model, capacity, &seed);
+    if (error)
+    {
+      printf("%s: step %ld: %s\n", name, step, error);
+      return 1;
+    }
+  }
+  printf("%s: %ld steps\n", name, steps);
+  return 0;
+
+} //  _testBuffer()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  long steps = (argc > 1) ? atol(argv[1]) : TEST_STEPS;
+  int failures = 0;
+
+  bufferStream segmented(5000); // not a multiple of the segment size
+  failures += _testBuffer("bufferStream(5000)", &segmented, 5000, steps);
+  static fixedBufferStream<4096> fixed;
+  failures += _testBuffer("fixedBufferStream<4096>", &fixed, 4096, steps);
+  return failures ? 1 : 0;
+
+} //  main()
+
+/*eof*/
@@ -0,0 +1,83 @@
+/* ***************************************************************************
+* File:    tests/test_cork.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### CORK TEST
+
+A corkStream must deliver all of its output to a client whose writes come back short, in
+small prints, printf() and writes larger than the cork. Its count() is what the client took
+plus what the cork still holds; output to a client which has gone is not counted.
+
+- usage: test_cork
+--- */
+
+#include "cmdParser.ino"
+#include "mockstream.h"
+
+static int _test_failures = 0;
+
+static void _testCheck(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAILED: %s\n", what);
+    _test_failures++;
+  }
+}
+
+//--------------------------------------------------------------------------
+// small prints, a printf() and writes larger than the cork, each once
+static std::string _testOutput(corkStream *cork)
+{
+  std::string expected;
+  for (int i = 0; i < 300; i++)
+  {
+    cork->print("line ");
+    expected += "line ";
+  }
+  cork->printf("%d %s\n", 42, "printf");
+  expected += "42 printf\n";
+  std::string large(3 * CORK_SIZE + 7, 'x');
+  cork->write((const uint8_t *)large.data(), large.size());
+  expected += large;
+  cork->print("end\n");
+  expected += "end\n";
+  return expected;
+
+} //  _testOutput()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  //-- every write of the client is short
+  mockStream client;
+  client.write_max = 100;
+  corkStream cork;
+  cork.begin(&client);
+  std::string expected = _testOutput(&cork);
+  _testCheck(cork.count() == expected.size(), "count() differs from the output before the flush");
+  cork.end();
+  _testCheck(client.out == expected, "short writes lost output");
+  printf("%zu bytes in %zu short writes\n", client.out.size(), client.write_calls);
+
+  //-- the client goes away in the middle of a large write
+  mockStream gone;
+  gone.out_max = 2 * CORK_SIZE;
+  cork.begin(&gone);
+  _testOutput(&cork);
+  cork.flush();
+  _testCheck(cork.count() == gone.out.size(), "count() includes output which the client did not take");
+  cork.end();
+
+  return _test_failures ? 1 : 0;
+
+} //  main()
+
+/*eof*/
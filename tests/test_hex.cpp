@@ -0,0 +1,184 @@
+/* ***************************************************************************
+* File:    tests/test_hex.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### HEX TEST
+
+The streaming Intel HEX decoder of hexfile.h. A HEX image which crosses several 64 KB
+boundaries is decoded in one piece, in random pieces and one character at a time, so records
+are split at every position; the blocks handed to the sink must give back the binary at the
+right addresses. Extended segment (02) and linear (04) address records must move the data.
+A wrong checksum, an odd number of digits, a bad address record and a missing end of file
+record must stop the decoder with their error.
+
+- usage: test_hex
+--- */
+
+#include "cmdParser.ino"
+#include "corpus.h"
+
+#include <map>
+
+static int _test_failures = 0;
+
+static void _testCheck(bool ok, const char *name, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAILED: %s: %s\n", name, what);
+    _test_failures++;
+  }
+}
+
+typedef struct
+{
+  std::map<uint32_t, std::string> blocks;
+  bool valid;                 // every block fits in HEX_BLOCK_SIZE and does not overlap the one before
+  uint32_t next;
+} testImage_t;
+
+static bool _testSink(void *ctx, uint32_t address, const uint8_t *data, size_t len)
+{
+  testImage_t *image = (testImage_t *)ctx;
+  if (!len || (len > HEX_BLOCK_SIZE) || (!image->blocks.empty() && (address < image->next)))
+    image->valid = false;
+  image->blocks[address].assign((const char *)data, len);
+  image->next = address + len;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// the pieces are 1 to max_piece characters; max_piece 0 hands over the text in one piece
+static uint8_t _testDecode(const std::string &text, unsigned int *seed, size_t max_piece, testImage_t *image)
+{
+  hexDecoder_t hex;
+  image->blocks.clear();
+  image->valid = true;
+  image->next = 0;
+  hexBegin(&hex, _testSink, image);
+  for (size_t pos = 0; pos < text.size();)
+  {
+    size_t len = max_piece ? (1 + (rand_r(seed) % max_piece)) : text.size();
+    if (len > (text.size() - pos))
+      len = text.size() - pos;
+    if (!hexDecode(&hex, (const uint8_t *)text.data() + pos, len))
+      break;
+    pos += len;
+  }
+  return hexFinish(&hex);
+
+} //  _testDecode()
+
+
+//--------------------------------------------------------------------------
+// joins the blocks which follow each other; returns false when there is a gap
+static bool _testJoin(const testImage_t &image, uint32_t *address, std::string *data)
+{
+  data->clear();
+  for (auto &block : image.blocks)
+  {
+    if (data->empty())
+      *address = block.first;
+    else if (block.first != (*address + data->size()))
+      return false;
+    *data += block.second;
+  }
+  return true;
+
+} //  _testJoin()
+
+
+//--------------------------------------------------------------------------
+static void _testImage(const char *name, const std::string &data, uint32_t address, uint8_t record_len, unsigned int *seed)
+{
+  static const size_t pieces[] = {0, 1, 7, 64, 2048};
+  std::string text = corpusHex(data, address, record_len);
+  for (size_t piece : pieces)
+  {
+    testImage_t image;
+    uint32_t at = 0;
+    std::string out;
+    _testCheck(_testDecode(text, seed, piece, &image) == HEX_OK, name, "the decoder found an error");
+    _testCheck(image.valid, name, "a block is too long or overlaps");
+    _testCheck(_testJoin(image, &at, &out), name, "the blocks have a gap");
+    _testCheck((at == address) && (out == data), name, "the decoded data differs");
+  }
+
+} //  _testImage()
+
+
+//--------------------------------------------------------------------------
+static void _testError(const char *name, const std::string &text, uint8_t error)
+{
+  unsigned int seed = 1;
+  testImage_t image;
+  uint8_t whole = _testDecode(text, &seed, 0, &image);
+  uint8_t split = _testDecode(text, &seed, 1, &image);
+  if ((whole != error) || (split != error))
+    printf("%s: expected \"%s\", got \"%s\" and \"%s\" one character at a time\n", name, hexErrorText(error), hexErrorText(whole), hexErrorText(split));
+  _testCheck((whole == error) && (split == error), name, "the wrong error");
+
+} //  _testError()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  unsigned int seed = 1;
+
+  //-- the images cross 64 KB boundaries; 0x0800FFF8 starts a record 8 bytes before one
+  _testImage("small", corpusBinary(100, 1), 0x00000000, 16, &seed);
+  _testImage("linear", corpusBinary(150000, 2), 0x0800FFF8, 16, &seed);
+  _testImage("long records", corpusBinary(70000, 3), 0x3FFF0000, 255, &seed);
+
+  //-- an extended segment address: 0x1234 << 4 plus the offset
+  uint8_t data[4] = {0xDE, 0xAD, 0xBE, 0xEF};
+  uint8_t segment[2] = {0x12, 0x34};
+  uint8_t linear[2] = {0x20, 0x00};
+  std::string text;
+  _corpusHexRecord(&text, 0x00, 0x0100, data, 4);
+  _corpusHexRecord(&text, 0x02, 0, segment, 2);
+  _corpusHexRecord(&text, 0x00, 0x0010, data, 4);
+  _corpusHexRecord(&text, 0x04, 0, linear, 2);
+  _corpusHexRecord(&text, 0x00, 0x0020, data, 4);
+  _corpusHexRecord(&text, 0x01, 0, NULL, 0);
+  testImage_t image;
+  _testCheck(_testDecode(text, &seed, 3, &image) == HEX_OK, "address records", "the decoder found an error");
+  std::string word((const char *)data, 4);
+  _testCheck((image.blocks.size() == 3) && (image.blocks[0x0100] == word) && (image.blocks[0x12350] == word) && (image.blocks[0x20000020] == word),
+             "address records", "the data is not at the addresses of the 02 and 04 records");
+
+  //-- the last record may end without a line end; anything after the end of file record is ignored
+  std::string good = corpusHex(corpusBinary(40, 4), 0x1000);
+  _testError("no line end", good.substr(0, good.size() - 2), HEX_OK);
+  _testError("after the end", good + "garbage", HEX_OK);
+
+  //-- broken records; the first data record follows the 04 record, so its checksum is at 17 + 9 + 32
+  std::string bad = good;
+  bad[17 + 9 + 32] = (bad[17 + 9 + 32] == '0') ? '1' : '0';
+  _testError("checksum", bad, HEX_ERR_CHECKSUM);
+  _testError("odd digits", good.substr(0, 20) + good.substr(21), HEX_ERR_FORMAT);
+  _testError("not a digit", good.substr(0, 20) + "G" + good.substr(21), HEX_ERR_FORMAT);
+  _testError("no colon", good.substr(1), HEX_ERR_FORMAT);
+  text.clear();
+  _corpusHexRecord(&text, 0x02, 0, data, 3);
+  _testError("02 length", text, HEX_ERR_RECORD);
+  text.clear();
+  _corpusHexRecord(&text, 0x04, 0, data, 4);
+  _testError("04 length", text, HEX_ERR_RECORD);
+  text.clear();
+  _corpusHexRecord(&text, 0x06, 0, data, 2);
+  _testError("record type", text, HEX_ERR_RECORD);
+  _testError("no end", good.substr(0, good.size() - 13), HEX_ERR_NO_EOF);
+
+  return _test_failures ? 1 : 0;
+
+} //  main()
+
+/*eof*/
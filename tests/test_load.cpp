@@ -0,0 +1,167 @@
+/* ***************************************************************************
+* File:    tests/test_load.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### LOAD TEST
+
+The TCP server of the sketch with 8, 16 and 32 concurrent connections. It is built with
+TCP_MAX_CLIENTS 32 and runs on the loopback interface (see tcpload.h). Every connection switches
+to KEEPALIVE and then sends one command at a time and waits for its response. Half of the
+commands are a CAT of a small file and half are a SIZE of a missing file, so each response
+must be the file or an error. The commands/s of each round and the median and p99 latency
+of a command are reported.
+
+One connection more than the pool holds must be turned away with an error.
+
+- usage: test_load <directory for the files> [commands per connection]
+--- */
+
+#define TCP_MAX_CLIENTS 32
+#define LOG_LEVEL       1   // messages only; the debug records of every command would flood the log ring
+
+#include "cmdParser.ino"
+#include "testfiles.h"
+#include "tcpload.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#define TEST_COMMANDS 200
+#define TEST_SETTLE   200 // ms for the server to see the connections of a round close and free their slots
+
+static int _test_failures = 0;
+
+static void _testCheck(bool ok, const char *name, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAILED: %s: %s\n", name, what);
+    _test_failures++;
+  }
+}
+
+typedef struct
+{
+  std::vector<double> latency;  // us of each command
+  int failures;
+} testConnection_t;
+
+static std::string _test_file;
+
+//--------------------------------------------------------------------------
+static void _testClient(testConnection_t *conn, int commands)
+{
+  tcpLoadClient_t client;
+  std::string body;
+  bool ok = false;
+  if (!tcpLoadConnect(&client) || !tcpLoadSend(&client, "keepalive\n") || !tcpLoadReply(&client, &body, &ok) || !ok)
+  {
+    conn->failures++;
+    tcpLoadClose(&client);
+    return;
+  }
+  for (int i = 0; i < commands; i++)
+  {
+    bool cat = (i & 1);
+    auto start = std::chrono::steady_clock::now();
+    if (!tcpLoadSend(&client, cat ? "cat load.txt\n" : "size nosuch.txt\n") || !tcpLoadReply(&client, &body, &ok))
+    {
+      conn->failures++;
+      break;
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    conn->latency.push_back(elapsed.count());
+    if (cat ? (!ok || (body != _test_file)) : (ok || strncmp(body.c_str(), "Error", 5)))
+      conn->failures++;
+  }
+  tcpLoadClose(&client);
+
+} //  _testClient()
+
+
+//--------------------------------------------------------------------------
+static void _testRound(int connections, int commands)
+{
+  std::vector<testConnection_t> conns(connections);
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < connections; i++)
+  {
+    conns[i].failures = 0;
+    threads.push_back(std::thread(_testClient, &conns[i], commands));
+  }
+  for (std::thread &thread : threads)
+    thread.join();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::this_thread::sleep_for(std::chrono::milliseconds(TEST_SETTLE));
+
+  std::vector<double> latency;
+  int failures = 0;
+  for (testConnection_t &conn : conns)
+  {
+    latency.insert(latency.end(), conn.latency.begin(), conn.latency.end());
+    failures += conn.failures;
+  }
+  char name[32];
+  snprintf(name, sizeof(name), "%d connections", connections);
+  _testCheck(!failures, name, "a command failed or got the wrong response");
+  _testCheck((int)latency.size() == (connections * commands), name, "a connection did not complete its commands");
+  if (latency.empty())
+    return;
+  std::sort(latency.begin(), latency.end());
+  printf("%-15s %6zu commands %9.0f commands/s  median %8.0f us  p99 %8.0f us\n", name, latency.size(), latency.size() / elapsed.count(),
+         latency[latency.size() / 2], latency[(latency.size() * 99) / 100]);
+
+} //  _testRound()
+
+
+//--------------------------------------------------------------------------
+// every slot is taken by a connection which waits in KEEPALIVE; one more must get an error
+static void _testFull()
+{
+  std::vector<tcpLoadClient_t> clients(TCP_MAX_CLIENTS);
+  std::string body;
+  bool ok = false;
+  bool held = true;
+  for (tcpLoadClient_t &client : clients)
+    held = held && tcpLoadConnect(&client) && tcpLoadSend(&client, "keepalive\n") && tcpLoadReply(&client, &body, &ok) && ok;
+  _testCheck(held, "full", "the pool did not take TCP_MAX_CLIENTS connections");
+
+  tcpLoadClient_t extra;
+  _testCheck(tcpLoadConnect(&extra) && (tcpLoadReadAll(&extra) == "Error: too many clients\n"), "full", "a connection beyond the pool was not turned away");
+  tcpLoadClose(&extra);
+  for (tcpLoadClient_t &client : clients)
+    tcpLoadClose(&client);
+
+} //  _testFull()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  int commands = (argc > 2) ? atoi(argv[2]) : TEST_COMMANDS;
+  tcpLoadSetup((argc > 1) ? argv[1] : NULL);
+  for (int i = 0; i < 20; i++)
+    _test_file += "line " + std::to_string(i) + " of the file which is sent by CAT\n";
+  testFilesWrite("load.txt", _test_file);
+
+  tcpLoadServerBegin();
+  _testRound(8, commands);
+  _testRound(16, commands);
+  _testRound(32, commands);
+  _testFull();
+  tcpLoadServerEnd();
+
+  filesysDelete("load.txt");
+  return _test_failures ? 1 : 0;
+
+} //  main()
+
+/*eof*/
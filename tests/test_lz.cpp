@@ -0,0 +1,142 @@
+/* ***************************************************************************
+* File:    tests/test_lz.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### LZ TEST
+
+Round trips through the streaming codec of lzstream.h. Every input is compressed and
+decompressed several times with random input and output chunk sizes, down to a single byte,
+and must come back unchanged. The inputs are empty, tiny, incompressible, repetitive, text
+and Intel HEX; all but the first two are longer than 8 KB, so the encoder slides its window.
+A stream which is cut short or does not start with the magic must be reported.
+
+- usage: test_lz
+--- */
+
+#include "cmdParser.ino"
+#include "corpus.h"
+
+#define TEST_ROUNDS 4
+
+static int _test_failures = 0;
+
+static void _testCheck(bool ok, const char *name, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAILED: %s: %s\n", name, what);
+    _test_failures++;
+  }
+}
+
+//--------------------------------------------------------------------------
+// the chunks are at most max_chunk bytes; the calls end when the encoder returns 0 with finish
+static std::string _testCompress(const std::string &data, unsigned int *seed, size_t max_chunk)
+{
+  lzEncoder_t enc;
+  if (!lzEncoderBegin(&enc))
+    return "";
+  std::string out;
+  uint8_t buf[4096];
+  size_t pos = 0;
+  for (;;)
+  {
+    size_t in_len = 1 + (rand_r(seed) % max_chunk);
+    if (in_len > (data.size() - pos))
+      in_len = data.size() - pos;
+    bool finish = ((pos + in_len) == data.size());
+    size_t count = lzEncode(&enc, (const uint8_t *)data.data() + pos, &in_len, buf, 1 + (rand_r(seed) % max_chunk), finish);
+    pos += in_len;
+    out.append((const char *)buf, count);
+    if (finish && (pos == data.size()) && !count)
+      break;
+  }
+  lzEncoderEnd(&enc);
+  return out;
+
+} //  _testCompress()
+
+
+//--------------------------------------------------------------------------
+// returns false when the decoder finds the stream is not valid
+static bool _testDecompress(const std::string &packed, unsigned int *seed, size_t max_chunk, std::string *out)
+{
+  lzDecoder_t dec;
+  if (!lzDecoderBegin(&dec))
+    return false;
+  uint8_t buf[4096];
+  size_t pos = 0;
+  for (;;)
+  {
+    size_t in_len = 1 + (rand_r(seed) % max_chunk);
+    if (in_len > (packed.size() - pos))
+      in_len = packed.size() - pos;
+    size_t count = lzDecode(&dec, (const uint8_t *)packed.data() + pos, &in_len, buf, 1 + (rand_r(seed) % max_chunk));
+    pos += in_len;
+    out->append((const char *)buf, count);
+    if (dec.error || ((pos == packed.size()) && !count))
+      break;
+  }
+  return lzDecoderEnd(&dec);
+
+} //  _testDecompress()
+
+
+//--------------------------------------------------------------------------
+static void _testRoundTrip(const char *name, const std::string &data, unsigned int *seed)
+{
+  static const size_t chunks[] = {1, 7, 512, 4096};
+  for (int round = 0; round < TEST_ROUNDS; round++)
+  {
+    size_t max_chunk = chunks[round % 4];
+    //-- a single byte per call is slow; it gets the start of the input only
+    std::string input = (max_chunk == 1) ? data.substr(0, 20000) : data;
+    std::string packed = _testCompress(input, seed, max_chunk);
+    std::string unpacked;
+    _testCheck(lzIsCompressed((const uint8_t *)packed.data(), packed.size()), name, "the stream has no magic");
+    _testCheck(_testDecompress(packed, seed, max_chunk, &unpacked), name, "the decoder found an error");
+    _testCheck(unpacked == input, name, "the round trip changed the data");
+    if (round == (TEST_ROUNDS - 1))
+      printf("%-14s %7zu -> %7zu bytes\n", name, input.size(), packed.size());
+  }
+
+} //  _testRoundTrip()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  unsigned int seed = 1;
+
+  std::string random;
+  for (int i = 0; i < 50000; i++)
+    random += (char)rand_r(&seed);
+  std::string repeat(100000, 'a');
+  for (size_t i = 0; i < repeat.size(); i += 997)
+    repeat[i] = 'b';
+
+  _testRoundTrip("empty", "", &seed);
+  _testRoundTrip("tiny", "ab", &seed);
+  _testRoundTrip("incompressible", random, &seed);
+  _testRoundTrip("repetitive", repeat, &seed);
+  _testRoundTrip("text", corpusText(100000, 2), &seed);
+  _testRoundTrip("hex", corpusHex(corpusBinary(40000, 3), 0x0800FC00), &seed);
+
+  //-- broken streams; a run of one byte ends in a match, which the cut splits
+  std::string packed = _testCompress(std::string(1000, 'a'), &seed, 512);
+  std::string out;
+  _testCheck(!_testDecompress(packed.substr(0, packed.size() - 1), &seed, 512, &out), "cut", "a stream cut inside a match was accepted");
+  out.clear();
+  _testCheck(!_testDecompress("LZS2" + packed.substr(4), &seed, 512, &out), "magic", "a stream with the wrong magic was accepted");
+
+  return _test_failures ? 1 : 0;
+
+} //  main()
+
+/*eof*/
@@ -0,0 +1,139 @@
+/* ***************************************************************************
+* File:    tests/test_pipeline.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### PIPELINE TEST
+
+Stress the producer/consumer pipe of pipeline.h with the writer on its own thread.
+Every round writes a random amount of data in random pieces, sometimes only as much as
+pipelineWritable() offers and sometimes more, into a sink which stalls at random.
+The sink must receive exactly the data, in order, in full blocks except the last one.
+A sink which fails must make pipelineWrite() and pipelineFinish() fail.
+
+The test is also built with ThreadSanitizer (test_pipeline_tsan) when the compiler has it.
+
+- usage: test_pipeline [rounds]
+--- */
+
+#include "cmdParser.ino"
+
+#include <chrono>
+#include <string>
+
+#define TEST_ROUNDS   300
+#define TEST_MAX_SIZE 50000
+
+typedef struct
+{
+  std::string data;
+  unsigned int seed;
+  size_t fail_at;       // the sink fails once it has this much data
+  bool short_block;     // a block shorter than PIPELINE_BLOCK_SIZE was seen
+  bool misordered;      // data came after a short block
+} testSink_t;
+
+static bool _testSink(void *ctx, const uint8_t *buf, size_t len)
+{
+  testSink_t *sink = (testSink_t *)ctx;
+  if (rand_r(&sink->seed) % 3 == 0)
+    std::this_thread::sleep_for(std::chrono::microseconds(rand_r(&sink->seed) % 200));
+  if (sink->short_block)
+    sink->misordered = true;
+  if (len < PIPELINE_BLOCK_SIZE)
+    sink->short_block = true;
+  sink->data.append((const char *)buf, len);
+  return sink->data.size() < sink->fail_at;
+}
+
+//--------------------------------------------------------------------------
+// returns an error message or NULL
+static const char *_testRound(unsigned int *seed, bool failing)
+{
+  std::string source;
+  size_t total = rand_r(seed) % TEST_MAX_SIZE;
+  for (size_t i = 0; i < total; i++)
+    source += (char)rand_r(seed);
+
+  failing = failing && total;
+
+  testSink_t sink;
+  sink.seed = rand_r(seed);
+  sink.fail_at = failing ? (1 + (rand_r(seed) % total)) : (size_t)-1;
+  sink.short_block = false;
+  sink.misordered = false;
+
+  pipeline_t pipe;
+  if (!pipelineBegin(&pipe, _testSink, &sink))
+    return "pipelineBegin() failed";
+
+  bool written = true;
+  size_t pos = 0;
+  while (pos < source.size())
+  {
+    size_t count = 1 + (rand_r(seed) % 3000);
+    if (count > (source.size() - pos))
+      count = source.size() - pos;
+    if (rand_r(seed) & 1)
+    {
+      //-- a producer which respects the back pressure
+      size_t room = pipelineWritable(&pipe);
+      if (!room)
+        continue;
+      if (count > room)
+        count = room;
+    }
+    written = pipelineWrite(&pipe, (const uint8_t *)source.data() + pos, count) && written;
+    pos += count;
+  }
+  bool finished = pipelineFinish(&pipe);
+
+  if (failing)
+  {
+    bool failed = (sink.data.size() >= sink.fail_at);
+    if (failed && finished)
+      return "pipelineFinish() did not report the failed sink";
+    if (!failed && !finished)
+      return "pipelineFinish() failed without a failing sink";
+    if (sink.data.compare(0, std::string::npos, source, 0, sink.data.size()))
+      return "the sink got different data";
+    return NULL;
+  }
+  if (!written || !finished)
+    return "the pipe failed";
+  if (sink.data != source)
+    return "the sink got different data";
+  if (sink.misordered)
+    return "a short block was not the last one";
+  return NULL;
+
+} //  _testRound()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  int rounds = (argc > 1) ? atoi(argv[1]) : TEST_ROUNDS;
+  unsigned int seed = 1;
+  int failures = 0;
+
+  for (int round = 0; round < rounds; round++)
+  {
+    const char *error = _testRound(&seed, (round % 4) == 3);
+    if (error)
+    {
+      printf("round %d: %s\n", round, error);
+      failures++;
+    }
+  }
+  printf("%d pipeline rounds, %d failed\n", rounds, failures);
+  return failures ? 1 : 0;
+
+} //  main()
+
+/*eof*/
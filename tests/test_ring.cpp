@@ -0,0 +1,67 @@
+/* ***************************************************************************
+* File:    tests/test_ring.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### RING TEST
+
+The ringStream between two threads, with every pairing of byte, copy and span calls
+(see ringload.h), at capacities from 1 byte to the one of the upload pipeline.
+The capacity must be rounded up to a power of two and every byte must arrive in order.
+A ring from new must be aligned to RING_CACHE_LINE.
+
+It is meant to run under ThreadSanitizer (test_ring_tsan); the plain build runs it too.
+
+- usage: test_ring [bytes per capacity]
+--- */
+
+#include "cmdParser.ino"
+#include "ringload.h"
+
+#define TEST_BYTES (1 << 20)
+
+int main(int argc, char **argv)
+{
+  size_t total = (argc > 1) ? atol(argv[1]) : TEST_BYTES;
+  static const uint32_t sizes[] = {1, 5, 64, 4096, PIPELINE_BLOCKS * PIPELINE_BLOCK_SIZE};
+  int failures = 0;
+
+  for (uint32_t size : sizes)
+  {
+    ringStream ring(size);
+    uint32_t expected = 1;
+    while (expected < size)
+      expected <<= 1;
+    if (ring.capacity() != expected)
+    {
+      printf("a %u byte ring has a capacity of %u\n", size, ring.capacity());
+      failures++;
+    }
+
+    ringLoad_t load = ringLoad(&ring, total, RING_LOAD_MIXED);
+    printf("capacity %5u: %zu bytes, %zu calls, %zu wrong\n", ring.capacity(), total, load.calls, load.errors);
+    if (load.errors || ring.available())
+      failures++;
+  }
+
+  //-- the pipeline allocates its ring; the two sides keep to their own cache lines only when it is aligned
+  for (int i = 0; i < 8; i++)
+  {
+    ringStream *ring = new ringStream(64);
+    if (!ring || ((uintptr_t)ring % RING_CACHE_LINE))
+    {
+      printf("a ring from new is not aligned to RING_CACHE_LINE\n");
+      failures++;
+    }
+    delete ring;
+  }
+  return failures ? 1 : 0;
+
+} //  main()
+
+/*eof*/
@@ -0,0 +1,134 @@
+/* ***************************************************************************
+* File:    tests/test_session.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### SESSION TEST
+
+A CAT in the middle of a batch must not hold up the loop: each poll sends a part of the
+file and the commands after it wait in the session until the file has been sent.
+A session which ends while it is sending does not wait for the client either: the file
+gets one more burst, the rest is dropped and the waiting commands still run.
+Command files which RUN each other stop at PARSER_RUN_DEPTH and the session goes on;
+a command file which ends in an incomplete command does not run.
+DIR hides the digest sidecars unless its pattern asks for hidden files.
+
+- usage: test_session <directory for the files>
+--- */
+
+#include "cmdParser.ino"
+#include "mockstream.h"
+#include "testfiles.h"
+
+#define TEST_CAT_SIZE 100000 // many bursts
+
+static int _test_failures = 0;
+
+static void _testCheck(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAILED: %s\n", what);
+    _test_failures++;
+  }
+}
+
+//--------------------------------------------------------------------------
+// the output of a script which has arrived in full
+static std::string _testRun(parserSession_t *session, const char *script)
+{
+  mockStream client(script);
+  parserSessionBegin(session, &client, false);
+  while (client.available() || parserSessionBusy(session))
+    parserSessionPoll(session);
+  parserSessionEnd(session);
+  return client.out;
+
+} //  _testRun()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  testFilesBegin((argc > 1) ? argv[1] : NULL);
+  parserInit();
+
+  std::string big;
+  for (int i = 0; i < TEST_CAT_SIZE; i++)
+    big += (char)('a' + (i % 26));
+  testFilesWrite("big.txt", big);
+
+  const char *script = "cat big.txt\ninfo 5 6\n";
+
+  //-- polled until it is done: the whole file, then the next command
+  mockStream client(script);
+  parserSession_t session;
+  parserSessionBegin(&session, &client, false);
+  parserSessionPoll(&session);
+  _testCheck(client.out.size() < TEST_CAT_SIZE, "the first poll sent all of the file");
+  _testCheck(parserSessionBusy(&session), "the session is not busy while it sends");
+  _testCheck(client.out.find("INFO") == std::string::npos, "INFO ran before the file was sent");
+  int polls = 1;
+  while (parserSessionBusy(&session))
+  {
+    parserSessionPoll(&session);
+    polls++;
+  }
+  parserSessionEnd(&session);
+  _testCheck(client.out.find("INFO: p1=[5], p2=[6]") == TEST_CAT_SIZE, "INFO does not follow the file");
+  printf("%d polls sent %d bytes\n", polls, TEST_CAT_SIZE);
+
+  //-- ended while it sends: one more burst and the rest of the file is dropped
+  mockStream ended(script);
+  parserSessionBegin(&session, &ended, false);
+  parserSessionPoll(&session);
+  parserSessionEnd(&session);
+  _testCheck(ended.out.find("INFO: p1=[5], p2=[6]") != std::string::npos, "INFO did not run after the file was dropped");
+  _testCheck(ended.out.size() < TEST_CAT_SIZE, "the end of the session waited for the file");
+  _testCheck(!parserSessionBusy(&session), "the session is busy after its end");
+  printf("ended session sent %zu bytes\n", ended.out.size());
+
+  //-- a.cmd and b.cmd RUN each other until the depth is reached
+  testFilesWrite("a.cmd", "info 1 2\nrun b.cmd\n");
+  testFilesWrite("b.cmd", "size a.cmd\nrun a.cmd\n");
+  std::string out = _testRun(&session, "run a.cmd\ninfo 7 8\n");
+  size_t runs = 0;
+  for (size_t at = 0; (at = out.find("Ran ", at)) != std::string::npos; at++)
+    runs++;
+  _testCheck(runs == PARSER_RUN_DEPTH, "the command files did not run to the depth");
+  _testCheck(out.find("too many nested command files") != std::string::npos, "the depth was not enforced");
+  _testCheck(out.find("RUN needs") == std::string::npos, "a RUN lost its parameter");
+  size_t last = out.rfind("INFO: p1=[7], p2=[8]");
+  _testCheck((last != std::string::npos) && (last > out.rfind("Ran a.cmd")), "the command after RUN did not run last");
+
+  //-- a command file which ends in an incomplete command does not run at all
+  testFilesWrite("c.cmd", "info 3 4\nsize");
+  out = _testRun(&session, "run c.cmd\n");
+  _testCheck(out.find("SIZE needs 1 parameter(s)") != std::string::npos, "the incomplete command was not reported");
+  _testCheck(out.find("INFO: p1=[3]") == std::string::npos, "a command file with an incomplete command ran");
+
+  //-- the digest sidecars are hidden from DIR; a name too long for a sidecar is reported
+  _testRun(&session, "upload s.txt\nsum\n");
+  out = _testRun(&session, "upload digest_name_is_too_long.txt\nx\n");
+  _testCheck(out.find("too long for a digest") != std::string::npos, "a file without a digest was not reported");
+  out = _testRun(&session, "dir\n");
+  _testCheck((out.find("s.txt") != std::string::npos) && (out.find(".s.txt.sum") == std::string::npos), "DIR listed a digest sidecar");
+  out = _testRun(&session, "dir .*\n");
+  _testCheck(out.find(".s.txt.sum") != std::string::npos, "DIR .* did not list the digest sidecar");
+
+  filesysDelete("big.txt");
+  filesysDelete("s.txt");
+  filesysDelete("digest_name_is_too_long.txt");
+  filesysDelete("a.cmd");
+  filesysDelete("b.cmd");
+  filesysDelete("c.cmd");
+  return _test_failures ? 1 : 0;
+
+} //  main()
+
+/*eof*/
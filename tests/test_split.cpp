@@ -0,0 +1,118 @@
+/* ***************************************************************************
+* File:    tests/test_split.cpp
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### SPLIT TEST
+
+A parser session must give the same output whatever pieces its input arrives in.
+The script is fed once in one piece and then cut at every byte boundary, and at every
+pair of boundaries (every third second cut), with one parserSessionPoll() per piece.
+The output and the uploaded file must not change.
+
+- usage: test_split <directory for the files>
+--- */
+
+#include "cmdParser.ino"
+#include "mockstream.h"
+#include "testfiles.h"
+
+#include <vector>
+
+#define SPLIT_CAT_SIZE 5000 // larger than a send burst, so CAT is still sending when the next piece arrives
+
+static std::string _splitReadFile(const char *name)
+{
+  std::string content;
+  File file = g_storage->open(name, "r");
+  int c;
+  while (file && ((c = file.read()) >= 0))
+    content += (char)c;
+  file.close();
+  return content;
+}
+
+//--------------------------------------------------------------------------
+// run the script with one poll per piece; the pieces end at the cuts
+static std::string _splitRun(const std::string &script, std::vector<size_t> cuts)
+{
+  filesysDelete("a.txt");
+
+  mockStream client(script);
+  parserSession_t session;
+  parserSessionBegin(&session, &client, false);
+  cuts.push_back(script.size());
+  for (size_t cut : cuts)
+  {
+    client.limit = cut;
+    parserSessionPoll(&session);
+  }
+  while (client.available() || parserSessionBusy(&session))
+    parserSessionPoll(&session);
+  parserSessionEnd(&session);
+
+  //-- the transfer rates differ from run to run
+  std::string out = client.out;
+  size_t at;
+  while ((at = out.find(" bytes in ")) != std::string::npos)
+    out.erase(at, out.find(')', at) - at + 1);
+  return out + "|a.txt|" + _splitReadFile("/a.txt");
+
+} //  _splitRun()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  testFilesBegin((argc > 1) ? argv[1] : NULL);
+  parserInit();
+
+  std::string cat;
+  for (int i = 0; i < SPLIT_CAT_SIZE; i++)
+    cat += (char)('a' + (i % 26));
+  testFilesWrite("cat.txt", cat);
+
+  static const char text[] = "help\r\nInfo 12 34  dir\ndel nosuch\ncat cat.txt\n  info 5 6\nupload a.txt\n  hello world\r\nline2\n\0x\n\0tail";
+  std::string script(text, sizeof(text) - 1);
+  std::string reference = _splitRun(script, {});
+  if ((reference.find("abcdefghijklmnopqrstuvwxyz") == std::string::npos) || (reference.find("|a.txt|") == std::string::npos) || (_splitReadFile("/a.txt").size() < 12))
+  {
+    printf("the script did not run:\n%s\n", reference.c_str());
+    return 1;
+  }
+
+  int differ = 0;
+  for (size_t i = 0; i <= script.size(); i++)
+  {
+    std::string out = _splitRun(script, {i});
+    if (out != reference)
+    {
+      if (!differ)
+        printf("cut at %zu:\n%s\n---- expected:\n%s\n", i, out.c_str(), reference.c_str());
+      differ++;
+    }
+  }
+  for (size_t i = 0; i < script.size(); i++)
+  {
+    for (size_t j = i; j <= script.size(); j += 3)
+    {
+      if (_splitRun(script, {i, j}) != reference)
+      {
+        if (!differ)
+          printf("cuts at %zu and %zu differ\n", i, j);
+        differ++;
+      }
+    }
+  }
+
+  printf("%zu byte script: %d of the split runs differ\n", script.size(), differ);
+  return differ ? 1 : 0;
+
+} //  main()
+
+/*eof*/
@@ -0,0 +1,48 @@
+#ifndef __TESTFILES_H
+#define __TESTFILES_H
+
+/* ***************************************************************************
+* File:    tests/testfiles.h
+*
+* This content may be redistributed and/or modified as outlined
+* under the MIT License
+*
+* ***************************************************************************** */
+
+/* ---
+--------------------------------------------------------------------------
+### TEST FILES
+
+The files of a host test. testFilesBegin() starts the storage in the directory of the test
+and deletes whatever an earlier run left there, so a test sees the same files on a clean
+checkout and on a rerun. testFilesWrite() creates a fixture through filesysOpen() and
+filesysClose(), so the RAM index knows the file just as it knows an upload.
+--- */
+
+#include <string>
+
+static void testFilesBegin(const char *directory)
+{
+  if (directory)
+    storageHostRoot(directory);
+  filesysInit();
+
+  //-- the cursor continues after the last name, so the files may be deleted while they are listed
+  filesysDir_t dir;
+  filesysEntry_t entry;
+  filesysDirBegin(&dir, NULL, true);
+  while (filesysDirNext(&dir, &entry))
+    filesysDelete(entry.name);
+  filesysDirEnd(&dir);
+}
+
+static void testFilesWrite(const char *name, const std::string &content)
+{
+  File file = filesysOpen(name, "w");
+  file.write((const uint8_t *)content.data(), content.size());
+  filesysClose(file);
+}
+
+#endif
+
+/*eof*/